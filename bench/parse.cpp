@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "ast.hpp"
+#include "diagnostic.hpp"
+
+/// The number of times every job count is timed, keeping the fastest run.
+#define REPETITIONS 5
+
+/// Generate a program of `statements` lets, with an if statement every tenth one.
+static std::string
+generate(int statements)
+{
+  std::string source{};
+
+  for (int i = 0; i < statements; i++)
+    {
+      source += fmt::format("let x{} := {} * 3 + (4 - x{}).\n", i, i, i);
+      if (i % 10 == 0)
+        source += "if x < 3 then print x #\\n. else let y := 2 * x. end\n";
+    }
+
+  return source;
+}
+
+/// Return the fastest time in milliseconds that parsing `tokens` on `jobs` threads takes.
+static double
+time_parse(const std::vector<cat::Token>& tokens, unsigned jobs)
+{
+  auto best{ 0.0 };
+
+  for (int i = 0; i < REPETITIONS; i++)
+    {
+      std::vector<cat::Diagnostic> diagnostics{};
+
+      auto start{ std::chrono::steady_clock::now() };
+      auto program{ cat::Parser(tokens, diagnostics).ParseParallel(jobs) };
+      auto end{ std::chrono::steady_clock::now() };
+
+      auto elapsed{ std::chrono::duration<double, std::milli>(end - start).count() };
+      best = i == 0 ? elapsed : std::min(best, elapsed);
+    }
+
+  return best;
+}
+
+/// Time parsing a generated program on every number of threads up to the number of cores.
+int
+main(int argc, char** argv)
+{
+  auto statements{ argc > 1 ? std::atoi(argv[1]) : 200000 };
+  auto cores{ std::max(1u, std::thread::hardware_concurrency()) };
+
+  // The tokens point into the source, so it has to outlive them.
+  auto source{ generate(statements) };
+  std::vector<cat::Diagnostic> diagnostics{};
+  auto tokens{ cat::Lexer{ source, diagnostics }.Lex() };
+
+  fmt::print("{} statements, {} tokens, {} cores\n", statements, tokens.size(), cores);
+  fmt::print("{:>5} {:>10} {:>8}\n", "jobs", "ms", "speedup");
+
+  auto sequential{ time_parse(tokens, 1) };
+  fmt::print("{:>5} {:>10.1f} {:>7.2f}x\n", 1, sequential, 1.0);
+
+  for (auto jobs = 2u; jobs <= cores; jobs *= 2)
+    {
+      auto elapsed{ time_parse(tokens, jobs) };
+      fmt::print("{:>5} {:>10.1f} {:>7.2f}x\n", jobs, elapsed, sequential / elapsed);
+    }
+
+  return 0;
+}
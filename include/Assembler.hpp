@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Instruction.hpp"
+
+namespace cat
+{
+
+/**
+ * Encode a stream of instructions into MIPS32 machine code and write it as
+ * a static little-endian ELF executable.
+ *
+ * The program is laid out like SPIM and MARS lay it out: the text segment
+ * starts at 0x00400000 with a small entry stub that points $gp 32K into
+ * the small data area at 0x10000000, calls main and then exits with
+ * syscall 10, and the objects of the data section follow each other in the
+ * data segment at 0x10010000. The small data area is zeroed by the loader
+ * rather than stored in the file. The pseudo-instructions the
+ * transpiler emits are expanded the way an assembler would, and every jump
+ * and branch is followed by a nop so the code runs the same whether or not
+ * the loader executes delay slots. Branches whose target is out of reach are inverted
+ * around a jump.
+ */
+class Assembler final
+{
+public:
+  static constexpr uint32_t text_address = 0x00400000;
+  static constexpr uint32_t data_address = 0x10010000;
+  static constexpr uint32_t small_data_address = 0x10000000;
+  static constexpr uint32_t global_pointer = small_data_address + 0x8000;
+
+  Assembler(const std::vector<Instruction>& instructions, const std::vector<Datum>& data,
+            uint32_t small_data_size)
+      : m_instructions{ instructions }, m_data{ data }, m_small_data_size{ small_data_size }
+  {
+  }
+
+  /// Append the executable to `out`.
+  void Assemble(fmt::memory_buffer& out);
+
+private:
+  /// Give every label an address, and return the size of the text segment.
+  uint32_t layout();
+  /// Return the number of words `instruction` is encoded in.
+  [[nodiscard]] int size(const Instruction& instruction, std::size_t index) const noexcept;
+  void encode(const Instruction& instruction, std::size_t index, uint32_t address);
+  [[nodiscard]] int32_t branch_offset(uint32_t address, int label) const noexcept;
+
+  void write_elf(fmt::memory_buffer& out) const;
+
+  const std::vector<Instruction>& m_instructions;
+  const std::vector<Datum>& m_data;
+  uint32_t m_small_data_size;
+
+  std::unordered_map<int, uint32_t> m_addresses = {};
+  /// The branches that are too far from their label to reach it.
+  std::vector<bool> m_far = {};
+  std::vector<uint32_t> m_text = {};
+  /// The bytes of the data segment.
+  std::string m_bytes = {};
+};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <any>
+
+#include "expr_visitor.hpp"
+#include "stmt_visitor.hpp"
+
+namespace cat
+{
+
+/**
+ * Fold constant subexpressions and apply algebraic identities in place.
+ *
+ * This pass runs on a resolved program, so that 'x - x' can be recognized
+ * by comparing slots. Every expression visitor returns the ast::Expr* that
+ * should take the place of the visited node; when it differs from the node,
+ * the node has already been deleted.
+ *
+ * Additions and subtractions are only folded when they don't overflow,
+ * since 'add' and 'sub' trap on overflow at runtime. Multiplications wrap,
+ * like 'mult' followed by 'mflo' does.
+ */
+class ConstantFolder final : public ExprVisitor, public StmtVisitor
+{
+public:
+  void Fold(ast::Program&);
+
+  /// The number of simplifications that were applied.
+  [[nodiscard]] int
+  folded() const noexcept
+  {
+    return m_folded;
+  }
+
+  void VisitProgram(ast::Program&) override;
+  void VisitLetStmt(ast::LetStmt&) override;
+  void VisitIfStmt(ast::IfStmt&) override;
+  void VisitForStmt(ast::ForStmt&) override;
+  void VisitPrintStmt(ast::PrintStmt&) override;
+  void VisitExprStmt(ast::ExprStmt&) override;
+
+  std::any VisitNumber(ast::Number&) override;
+  std::any VisitString(ast::String&) override;
+  std::any VisitIdentifier(ast::Identifier&) override;
+  std::any VisitAddExpr(ast::AddExpr&) override;
+  std::any VisitSubExpr(ast::SubExpr&) override;
+  std::any VisitMultExpr(ast::MultExpr&) override;
+  std::any VisitAssignExpr(ast::AssignExpr&) override;
+  std::any VisitComparisonExpr(ast::ComparisonExpr&) override;
+
+private:
+  [[nodiscard]] ast::Expr* fold(ast::Expr*);
+
+  /// Fold both operands of a binary expression.
+  void fold_operands(ast::BinaryExpr&);
+
+  /// Move a constant left operand of a commutative expression to the right.
+  void canonicalize(ast::BinaryExpr&) noexcept;
+
+  /// Delete `expr`, except for `replacement` if it is one of its operands.
+  [[nodiscard]] ast::Expr* replace(ast::BinaryExpr& expr, ast::Expr* replacement);
+
+  int m_folded = 0;
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <any>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "expr_visitor.hpp"
+#include "stmt_visitor.hpp"
+
+namespace cat
+{
+
+/**
+ * Remove code whose result is never observed.
+ *
+ * - Variables that are never read lose their declaration and the assignments
+ *   to them. If their value has side effects it is still evaluated.
+ * - Expression statements without side effects are removed.
+ * - Branches of if statements whose condition is a constant are removed.
+ *
+ * This pass runs on a resolved and folded program. Removing declarations
+ * shifts the stack slots of the variables declared after them, so the
+ * program must be resolved again before code generation.
+ */
+class DeadCodeEliminator final : public ExprVisitor, public StmtVisitor
+{
+public:
+  /// Remove dead code until there is nothing left to remove.
+  void Eliminate(ast::Program&);
+
+  /// The number of statements that were removed or replaced.
+  [[nodiscard]] int
+  removed_statements() const noexcept
+  {
+    return m_removed_statements;
+  }
+
+  /// The number of if statement branches that were removed.
+  [[nodiscard]] int
+  pruned_branches() const noexcept
+  {
+    return m_pruned_branches;
+  }
+
+  void VisitProgram(ast::Program&) override;
+  void VisitLetStmt(ast::LetStmt&) override;
+  void VisitIfStmt(ast::IfStmt&) override;
+  void VisitForStmt(ast::ForStmt&) override;
+  void VisitPrintStmt(ast::PrintStmt&) override;
+  void VisitExprStmt(ast::ExprStmt&) override;
+
+  std::any VisitNumber(ast::Number&) override;
+  std::any VisitString(ast::String&) override;
+  std::any VisitIdentifier(ast::Identifier&) override;
+  std::any VisitAddExpr(ast::AddExpr&) override;
+  std::any VisitSubExpr(ast::SubExpr&) override;
+  std::any VisitMultExpr(ast::MultExpr&) override;
+  std::any VisitAssignExpr(ast::AssignExpr&) override;
+  std::any VisitComparisonExpr(ast::ComparisonExpr&) override;
+
+private:
+  /// Remove the dead statements from `stmts`, returning true if any was removed.
+  bool sweep(std::vector<ast::Stmt*>& stmts);
+  bool sweep(std::vector<std::unique_ptr<ast::Stmt> >& stmts);
+
+  /// Rewrite the dead assignments in `expr`, returning the expression to use in its place.
+  [[nodiscard]] ast::Expr* rewrite(ast::Expr* expr);
+
+  [[nodiscard]] bool is_read(const ast::LetStmt&) const noexcept;
+
+  /// The number of reads of every declared variable.
+  std::unordered_map<const ast::LetStmt*, int> m_reads = {};
+  /// The declaration that every assignment writes to.
+  std::unordered_map<const ast::AssignExpr*, const ast::LetStmt*> m_assignments = {};
+
+  /// The statement that replaces the one being swept, or nullptr to remove it.
+  ast::Stmt* m_replacement = nullptr;
+  /// The argument of the print statement being rewritten.
+  const ast::Expr* m_print_argument = nullptr;
+  bool m_changed = false;
+
+  int m_removed_statements = 0;
+  int m_pruned_branches = 0;
+};
+
+}
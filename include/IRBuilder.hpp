@@ -0,0 +1,99 @@
+#pragma once
+
+#include <any>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "expr_visitor.hpp"
+#include "ir.hpp"
+#include "stmt_visitor.hpp"
+
+namespace cat
+{
+
+/**
+ * Lower a resolved program to a function in SSA form.
+ *
+ * Variables are identified by their slot and converted to SSA values while
+ * the program is lowered, following "Simple and Efficient Construction of
+ * Static Single Assignment Form" by Braun et al. A block is sealed once all
+ * of its predecessors are known, and phis are only created for variables
+ * that are actually read after control flow joins.
+ *
+ * The operands of an expression are lowered in the order of their
+ * Sethi-Ullman numbers: the operand needing more registers goes first, so
+ * that fewer values are live while the other one is computed. Operands are
+ * only swapped when neither of them assigns a variable.
+ */
+class IRBuilder final : public ExprVisitor, public StmtVisitor
+{
+public:
+  [[nodiscard]] std::unique_ptr<ir::Function> Build(ast::Program&);
+
+  void VisitProgram(ast::Program&) override;
+  void VisitLetStmt(ast::LetStmt&) override;
+  void VisitIfStmt(ast::IfStmt&) override;
+  void VisitForStmt(ast::ForStmt&) override;
+  void VisitPrintStmt(ast::PrintStmt&) override;
+  void VisitExprStmt(ast::ExprStmt&) override;
+
+  std::any VisitNumber(ast::Number&) override;
+  std::any VisitString(ast::String&) override;
+  std::any VisitIdentifier(ast::Identifier&) override;
+  std::any VisitAddExpr(ast::AddExpr&) override;
+  std::any VisitSubExpr(ast::SubExpr&) override;
+  std::any VisitMultExpr(ast::MultExpr&) override;
+  std::any VisitAssignExpr(ast::AssignExpr&) override;
+  std::any VisitComparisonExpr(ast::ComparisonExpr&) override;
+
+private:
+  /// The register need of an expression and whether it is free of side effects.
+  struct Label
+  {
+    int need;
+    bool pure;
+  };
+
+  ir::Instruction* lower(ast::Expr*);
+  /// Lower the operands of `expr`, returning them in source order.
+  [[nodiscard]] std::pair<ir::Instruction*, ir::Instruction*> lower_operands(ast::BinaryExpr& expr);
+  /// Label `expr` and its subexpressions with their Sethi-Ullman number.
+  Label label(ast::Expr* expr);
+
+  ir::Instruction* emit(ir::Opcode, std::vector<ir::Instruction*> operands = {}, int imm = 0);
+
+  ir::BasicBlock* create_block();
+
+  void write_variable(int slot, ir::BasicBlock*, ir::Instruction* value);
+  [[nodiscard]] ir::Instruction* read_variable(int slot, ir::BasicBlock*);
+  [[nodiscard]] ir::Instruction* read_variable_recursive(int slot, ir::BasicBlock*);
+  ir::Instruction* add_phi_operands(int slot, ir::Instruction* phi);
+  /// Remove `phi` if every predecessor provides the same value, returning the value to use instead.
+  ir::Instruction* remove_trivial_phi(ir::Instruction* phi);
+
+  /// Mark `block` as having all of its predecessors, completing its phis.
+  void seal(ir::BasicBlock*);
+
+  std::unique_ptr<ir::Function> m_function = {};
+  /// The block new instructions are appended to.
+  ir::BasicBlock* m_block = nullptr;
+
+  /// The current value of every variable at the end of every block, indexed by block id.
+  std::vector<std::unordered_map<int, ir::Instruction*> > m_definitions = {};
+  /// The phis created in blocks that were not sealed yet, with their slot.
+  std::vector<std::vector<std::pair<int, ir::Instruction*> > > m_incomplete_phis = {};
+  std::vector<bool> m_sealed = {};
+  /// The phis that were read while their operands were added, around a loop back to their block.
+  std::unordered_set<const ir::Instruction*> m_cyclic_phis = {};
+
+  /// The labels of the binary expressions lowered so far.
+  std::unordered_map<const ast::Expr*, Label> m_labels = {};
+  /// The number of every string literal of the function, by its text.
+  std::unordered_map<std::string, int> m_strings = {};
+};
+
+}
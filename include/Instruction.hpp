@@ -1,282 +1,396 @@
 #pragma once
 
-#include <fmt/color.h>
+#include <cstdint>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "register.hpp"
 
 namespace cat
 {
 
+/**
+ * A MIPS instruction, or a label in the instruction stream.
+ *
+ * Every instruction is the same 8 byte record: an opcode, the numbers of
+ * the registers it writes and reads, and an immediate that also holds the
+ * label it defines, branches to or loads. Labels are numbers, printed as
+ * L followed by the number. Passes can inspect and rewrite the records
+ * without knowing their exact kind, and nothing is formatted until the
+ * whole listing is written. The nested classes build the instructions of
+ * every kind from their assembly operands.
+ */
 class Instruction
 {
 public:
-  virtual ~Instruction(){};
-
-  virtual std::string to_s() const noexcept = 0;
-
+  enum class Opcode : uint8_t
+  {
+    LABEL,
+    LI,
+    LA,
+    MOVE,
+    ADD,
+    ADDU,
+    SUB,
+    SUBU,
+    MULT,
+    MFLO,
+    DIVU,
+    MFHI,
+    ADDI,
+    LW,
+    SW,
+    LBU,
+    SB,
+    SLT,
+    SLTU,
+    SLTI,
+    SLTIU,
+    MOVN,
+    MOVZ,
+    XOR,
+    XORI,
+    ORI,
+    LUI,
+    SLL,
+    BEQ,
+    BNE,
+    BLTZ,
+    BGEZ,
+    BLEZ,
+    BGTZ,
+    J,
+    JAL,
+    JR,
+    SYSCALL
+  };
+
+  /// The register number of an operand an instruction does not have.
+  static constexpr int none = 0xff;
+
+  /// Return true if this instruction reads `reg`.
+  [[nodiscard]] bool reads(register_t reg) const noexcept;
+  /// Return true if this instruction writes `reg`.
+  [[nodiscard]] bool writes(register_t reg) const noexcept;
+  /// Return true if control can leave or enter the stream at this instruction.
+  [[nodiscard]] bool is_control() const noexcept;
+
+  Opcode op;
+  /// The register written, if any.
+  uint8_t rd;
+  /// The registers read, if any.
+  uint8_t rs;
+  uint8_t rt;
+  /// The immediate, shift amount, memory offset or label.
+  int32_t imm;
+
+  class LABEL;
   class LI;
   class LA;
   class MOVE;
   class ADD;
+  class ADDU;
   class SUB;
   class SUBU;
   class MULT;
   class MFLO;
+  class DIVU;
+  class MFHI;
   class ADDI;
   class LW;
   class SW;
+  class LBU;
+  class SB;
   class SLT;
   class SLTU;
+  class SLTI;
+  class SLTIU;
+  class MOVN;
+  class MOVZ;
+  class XOR;
   class XORI;
+  class ORI;
+  class LUI;
+  class SLL;
+  class BEQ;
+  class BNE;
+  class BLTZ;
+  class BGEZ;
+  class BLEZ;
+  class BGTZ;
+  class J;
+  class JAL;
+  class JR;
+  class SYSCALL;
+
+protected:
+  constexpr
+  Instruction(Opcode op, register_t rd, register_t rs, register_t rt, int32_t imm = 0) noexcept
+      : op{ op }, rd{ static_cast<uint8_t>(rd) }, rs{ static_cast<uint8_t>(rs) },
+        rt{ static_cast<uint8_t>(rt) }, imm{ imm }
+  {
+  }
+};
+
+static_assert(sizeof(Instruction) == 8 && std::is_trivially_copyable_v<Instruction>);
+
+/// An object of the data section: a string literal, or `size` zero bytes.
+struct Datum
+{
+  int label;
+  /// The literal as written in the source, quotes included, or nothing.
+  std::string literal = {};
+  int size = 0;
+  /// False if the literal runs on into the next datum, which ends it.
+  bool terminated = true;
 };
 
-class Instruction::LI : public Instruction
+/// Append the assembly of `instructions` to `out`, one line each.
+void write(fmt::memory_buffer& out, const std::vector<Instruction>& instructions);
+/// Append the directives that define `data` to `out`, one line each.
+void write(fmt::memory_buffer& out, const std::vector<Datum>& data);
+
+class Instruction::LABEL final : public Instruction
 {
 public:
-  LI(const std::string& reg, int value) : reg_{ reg }, value_{ value } {}
-
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}", "li", reg_, value_);
-  }
+  LABEL(int name) : Instruction{ Opcode::LABEL, none, none, none, name } {}
+};
 
-private:
-  std::string reg_;
-  int value_;
+class Instruction::LI final : public Instruction
+{
+public:
+  LI(register_t rd, int value) : Instruction{ Opcode::LI, rd, none, none, value } {}
 };
 
 class Instruction::LA final : public Instruction
 {
 public:
-  LA(const std::string& rd, const std::string& addr) : m_rd{ rd }, m_addr{ addr } {}
+  LA(register_t rd, int address) : Instruction{ Opcode::LA, rd, none, none, address } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}", "la", m_rd, m_addr);
-  }
+class Instruction::MOVE final : public Instruction
+{
+public:
+  MOVE(register_t rd, register_t rs) : Instruction{ Opcode::MOVE, rd, rs, none } {}
+};
 
-private:
-  std::string m_rd;
-  std::string m_addr;
+class Instruction::ADD final : public Instruction
+{
+public:
+  ADD(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::ADD, rd, rs, rt } {}
 };
 
-class Instruction::MOVE : public Instruction
+class Instruction::ADDU final : public Instruction
 {
 public:
-  MOVE(const std::string& r1, const std::string& r2) : r1_{ r1 }, r2_{ r2 } {}
+  ADDU(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::ADDU, rd, rs, rt } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}", "move", r1_, r2_);
-  }
+class Instruction::SUB final : public Instruction
+{
+public:
+  SUB(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::SUB, rd, rs, rt } {}
+};
 
-private:
-  std::string r1_;
-  std::string r2_;
+class Instruction::SUBU final : public Instruction
+{
+public:
+  SUBU(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::SUBU, rd, rs, rt } {}
 };
 
-class Instruction::MFLO : public Instruction
+class Instruction::MULT final : public Instruction
 {
 public:
-  MFLO(const std::string& r) : r_{ r } {}
+  MULT(register_t rs, register_t rt) : Instruction{ Opcode::MULT, none, rs, rt } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}", "mflo", r_);
-  }
+class Instruction::MFLO final : public Instruction
+{
+public:
+  MFLO(register_t rd) : Instruction{ Opcode::MFLO, rd, none, none } {}
+};
 
-private:
-  std::string r_;
+class Instruction::DIVU final : public Instruction
+{
+public:
+  DIVU(register_t rs, register_t rt) : Instruction{ Opcode::DIVU, none, rs, rt } {}
 };
 
-class Instruction::ADD : public Instruction
+class Instruction::MFHI final : public Instruction
 {
 public:
-  ADD(const std::string& rd, const std::string& rs, const std::string& rt) : rd_{ rd }, rs_{ rs }, rt_{ rt }
-  {
-  }
+  MFHI(register_t rd) : Instruction{ Opcode::MFHI, rd, none, none } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}, {}", "add", rd_, rs_, rt_);
-  }
+class Instruction::ADDI final : public Instruction
+{
+public:
+  ADDI(register_t rd, register_t rs, int constant) : Instruction{ Opcode::ADDI, rd, rs, none, constant } {}
+};
 
-private:
-  std::string rd_;
-  std::string rs_;
-  std::string rt_;
+class Instruction::LW final : public Instruction
+{
+public:
+  LW(register_t rt, int offset, register_t rs) : Instruction{ Opcode::LW, rt, rs, none, offset } {}
 };
 
-class Instruction::SUB : public Instruction
+class Instruction::SW final : public Instruction
 {
 public:
-  SUB(const std::string& rd, const std::string& rs, const std::string& rt) : rd_{ rd }, rs_{ rs }, rt_{ rt }
-  {
-  }
+  SW(register_t rt, int offset, register_t rs) : Instruction{ Opcode::SW, none, rs, rt, offset } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}, {}", "sub", rd_, rs_, rt_);
-  }
+class Instruction::LBU final : public Instruction
+{
+public:
+  LBU(register_t rt, int offset, register_t rs) : Instruction{ Opcode::LBU, rt, rs, none, offset } {}
+};
 
-private:
-  std::string rd_;
-  std::string rs_;
-  std::string rt_;
+class Instruction::SB final : public Instruction
+{
+public:
+  SB(register_t rt, int offset, register_t rs) : Instruction{ Opcode::SB, none, rs, rt, offset } {}
 };
 
-class Instruction::SUBU : public Instruction
+class Instruction::SLT final : public Instruction
 {
 public:
-  SUBU(const std::string& rd, const std::string& rs, const std::string& rt) : rd_{ rd }, rs_{ rs }, rt_{ rt }
-  {
-  }
+  SLT(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::SLT, rd, rs, rt } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}, {}", "subu", rd_, rs_, rt_);
-  }
+class Instruction::SLTU final : public Instruction
+{
+public:
+  SLTU(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::SLTU, rd, rs, rt } {}
+};
 
-private:
-  std::string rd_;
-  std::string rs_;
-  std::string rt_;
+class Instruction::SLTI final : public Instruction
+{
+public:
+  SLTI(register_t rt, register_t rs, int immediate) : Instruction{ Opcode::SLTI, rt, rs, none, immediate } {}
 };
 
-class Instruction::MULT : public Instruction
+/// Compare rs with the sign-extended immediate as unsigned numbers, so sltiu rt, rs, 1 tests rs for zero.
+class Instruction::SLTIU final : public Instruction
 {
 public:
-  MULT(const std::string& r1, const std::string& r2) : r1_{ r1 }, r2_{ r2 } {}
+  SLTIU(register_t rt, register_t rs, int immediate) : Instruction{ Opcode::SLTIU, rt, rs, none, immediate } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}", "mult", r1_, r2_);
-  }
+/// Copy rs to rd if rt is not zero. The old value of rd is kept otherwise, so it is read too.
+class Instruction::MOVN final : public Instruction
+{
+public:
+  MOVN(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::MOVN, rd, rs, rt } {}
+};
 
-private:
-  std::string r1_;
-  std::string r2_;
+/// Copy rs to rd if rt is zero.
+class Instruction::MOVZ final : public Instruction
+{
+public:
+  MOVZ(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::MOVZ, rd, rs, rt } {}
 };
 
-class Instruction::ADDI : public Instruction
+class Instruction::XOR final : public Instruction
 {
 public:
-  ADDI(const std::string& rd, const std::string& rs, int constant)
-      : rd_{ rd }, rs_{ rs }, constant_{ constant }
-  {
-  }
+  XOR(register_t rd, register_t rs, register_t rt) : Instruction{ Opcode::XOR, rd, rs, rt } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
+class Instruction::XORI final : public Instruction
+{
+public:
+  XORI(register_t rt, register_t rs, uint32_t immediate)
+      : Instruction{ Opcode::XORI, rt, rs, none, static_cast<int>(immediate) }
   {
-    return fmt::format("{:5}{}, {}, {}", "addi", rd_, rs_, constant_);
   }
-
-private:
-  std::string rd_;
-  std::string rs_;
-  int constant_;
 };
 
-class Instruction::LW : public Instruction
+class Instruction::ORI final : public Instruction
 {
 public:
-  LW(const std::string& rt, int offset, const std::string& rs) : rs_{ rs }, rt_{ rt }, offset_{ offset } {}
-
-  [[nodiscard]] std::string
-  to_s() const noexcept override
+  ORI(register_t rt, register_t rs, uint32_t immediate)
+      : Instruction{ Opcode::ORI, rt, rs, none, static_cast<int>(immediate) }
   {
-    return fmt::format("{:5}{}, {}({})", "lw", rt_, offset_, rs_);
   }
-
-private:
-  std::string rs_ = {};
-  std::string rt_ = {};
-  int offset_ = {};
 };
 
-class Instruction::SW : public Instruction
+class Instruction::LUI final : public Instruction
 {
 public:
-  SW(const std::string& rt, int offset, const std::string& rs) : rs_{ rs }, rt_{ rt }, offset_{ offset } {}
-
-  [[nodiscard]] std::string
-  to_s() const noexcept override
+  LUI(register_t rt, uint32_t immediate)
+      : Instruction{ Opcode::LUI, rt, none, none, static_cast<int>(immediate) }
   {
-    return fmt::format("{:5}{}, {}({})", "sw", rt_, offset_, rs_);
   }
+};
 
-private:
-  std::string rs_ = {};
-  std::string rt_ = {};
-  int offset_ = {};
+class Instruction::SLL final : public Instruction
+{
+public:
+  SLL(register_t rd, register_t rt, int shift) : Instruction{ Opcode::SLL, rd, rt, none, shift } {}
 };
 
-class Instruction::SLT : public Instruction
+class Instruction::BEQ final : public Instruction
 {
 public:
-  SLT(const std::string& rd, const std::string& rs, const std::string& rt)
-      : m_rd{ rd }, m_rs{ rs }, m_rt{ rt }
-  {
-  }
+  BEQ(register_t rs, register_t rt, int label) : Instruction{ Opcode::BEQ, none, rs, rt, label } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}, {}", "slt", m_rd, m_rs, m_rt);
-  }
+class Instruction::BNE final : public Instruction
+{
+public:
+  BNE(register_t rs, register_t rt, int label) : Instruction{ Opcode::BNE, none, rs, rt, label } {}
+};
 
-private:
-  std::string m_rd = {};
-  std::string m_rs = {};
-  std::string m_rt = {};
+class Instruction::BLTZ final : public Instruction
+{
+public:
+  BLTZ(register_t rs, int label) : Instruction{ Opcode::BLTZ, none, rs, none, label } {}
 };
 
-class Instruction::SLTU : public Instruction
+class Instruction::BGEZ final : public Instruction
 {
 public:
-  SLTU(const std::string& rd, const std::string& rs, const std::string& rt)
-      : m_rd{ rd }, m_rs{ rs }, m_rt{ rt }
-  {
-  }
+  BGEZ(register_t rs, int label) : Instruction{ Opcode::BGEZ, none, rs, none, label } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}, {}", "sltu", m_rd, m_rs, m_rt);
-  }
+class Instruction::BLEZ final : public Instruction
+{
+public:
+  BLEZ(register_t rs, int label) : Instruction{ Opcode::BLEZ, none, rs, none, label } {}
+};
 
-private:
-  std::string m_rd = {};
-  std::string m_rs = {};
-  std::string m_rt = {};
+class Instruction::BGTZ final : public Instruction
+{
+public:
+  BGTZ(register_t rs, int label) : Instruction{ Opcode::BGTZ, none, rs, none, label } {}
 };
 
-class Instruction::XORI : public Instruction
+class Instruction::J final : public Instruction
 {
 public:
-  XORI(const std::string& rt, const std::string& rs, uint32_t immediate)
-      : m_rt{ rt }, m_rs{ rs }, m_immediate{ immediate }
-  {
-  }
+  J(int label) : Instruction{ Opcode::J, none, none, none, label } {}
+};
 
-  [[nodiscard]] std::string
-  to_s() const noexcept override
-  {
-    return fmt::format("{:5}{}, {}, {}", "xori", m_rt, m_rs, m_immediate);
-  }
+class Instruction::JAL final : public Instruction
+{
+public:
+  JAL(int label) : Instruction{ Opcode::JAL, register_t::name::RA, none, none, label } {}
+};
 
-private:
-  std::string m_rt = {};
-  std::string m_rs = {};
-  uint32_t m_immediate = {};
+class Instruction::JR final : public Instruction
+{
+public:
+  JR(register_t rs) : Instruction{ Opcode::JR, none, rs, none } {}
+};
+
+class Instruction::SYSCALL final : public Instruction
+{
+public:
+  SYSCALL() : Instruction{ Opcode::SYSCALL, none, none, none } {}
 };
 
 }
@@ -50,6 +50,20 @@ public:
     return std::string{ m_lexeme.data(), m_lexeme.size() };
   }
 
+  /// Return a view of this token's lexeme into the source code.
+  [[nodiscard]] constexpr std::string_view
+  lexeme_view() const noexcept
+  {
+    return m_lexeme;
+  }
+
+  /// Return true if this token's lexeme is `lexeme`, without copying it.
+  [[nodiscard]] constexpr bool
+  is(std::string_view lexeme) const noexcept
+  {
+    return m_lexeme == lexeme;
+  }
+
   [[nodiscard]] constexpr TokenType
   type() const noexcept
   {
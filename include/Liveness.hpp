@@ -0,0 +1,53 @@
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+#include "ir.hpp"
+
+namespace cat
+{
+
+/**
+ * The values that are live on entry to and on exit from every block.
+ *
+ * A phi is defined on entry to its block, and its operands are used on exit
+ * from the matching predecessors. Constants and string addresses are not
+ * tracked: they are rematerialized wherever they are used.
+ *
+ * The sets are computed by walking backwards from every use to the
+ * definition, as in "Computing Liveness Sets for SSA-Form Programs" by
+ * Brandner et al., which needs no fixed point iteration.
+ */
+class Liveness
+{
+public:
+  using ValueSet = std::unordered_set<const ir::Instruction*>;
+
+  explicit Liveness(const ir::Function& function);
+
+  [[nodiscard]] const ValueSet&
+  live_in(const ir::BasicBlock& block) const noexcept
+  {
+    return m_live_in[block.id];
+  }
+
+  [[nodiscard]] const ValueSet&
+  live_out(const ir::BasicBlock& block) const noexcept
+  {
+    return m_live_out[block.id];
+  }
+
+  /// Return true if `value` is a value whose liveness is tracked.
+  [[nodiscard]] static bool is_tracked(const ir::Instruction& value) noexcept;
+
+private:
+  /// Mark `value` live on entry to `block` and on exit from the blocks before it, up to its definition.
+  void propagate(const ir::Instruction* value, ir::BasicBlock* block);
+
+  std::vector<ValueSet> m_live_in = {};
+  std::vector<ValueSet> m_live_out = {};
+  std::vector<ir::BasicBlock*> m_worklist = {};
+};
+
+}
@@ -1,204 +1,200 @@
 #pragma once
 
-#include <any>
-#include <bitset>
-#include <cassert>
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+#include <fmt/format.h>
+
+#include "Peephole.hpp"
+#include "RegisterAllocator.hpp"
 #include "diagnostic.hpp"
-#include "expr_visitor.hpp"
-#include "stmt_visitor.hpp"
+#include "ir.hpp"
+#include "register.hpp"
 
 namespace cat
 {
 
-// Forward declarations
-class Instruction;
-
-class register_t
+/**
+ * Select MIPS instructions for a function in SSA form.
+ *
+ * Values live where the register allocator put them. Operands that live in
+ * memory are loaded into a scratch register borrowed for the instruction
+ * using them, and results that live in memory are computed in $t8 and
+ * stored right after. The copies to the phis of a block are made at the end
+ * of its predecessors, in an order that reads every location before
+ * overwriting it.
+ *
+ * The spilled values live at fixed addresses in a small data area at
+ * 0x10000000, which $gp points 32K into the way SPIM and MARS set it up,
+ * so every slot is a single lw or sw off $gp and main needs no stack frame.
+ *
+ * Constants and string addresses are materialized where they are used.
+ * Arithmetic and comparisons are covered by the cheapest of a table of
+ * tiles, patterns of instructions over an operation and its operands, so
+ * constants become the immediates of addi, slti, sltiu and xori when they
+ * fit and multiplications by constants that are a power of two, or one
+ * away from it, become shifts and additions rather than a round trip
+ * through HI and LO. Comparisons that are only tested by a branch are not
+ * materialized: the branch compares the operands itself. Selects are
+ * conditional moves, so the if statements turned into them run without a
+ * branch. Blocks that only jump on, like the ones splitting the back edge
+ * of a loop once its phis share registers, are not emitted: the jumps to
+ * them go straight to where they lead.
+ *
+ * The instructions are kept in memory until the whole function is selected,
+ * so that a peephole pass can clean up what selecting one IR instruction at
+ * a time leaves behind before they are printed as assembly or encoded into
+ * an executable.
+ *
+ * Programs that print more than once, or in a loop, print through a small
+ * runtime emitted after main: the prints append to a buffer in the small
+ * data area, which is written with a single syscall when it fills up and
+ * when main returns. The routines of the runtime take their argument in
+ * $a0 and only clobber $v0 to $a3, $t8, $t9, HI and LO, none of which the
+ * register allocator keeps values in across a print.
+ */
+class MIPSTranspiler final
 {
 public:
-  static const int min_value = 8;
-  static const int max_value = 25;
-  static const int size = max_value - min_value;
-
-  // TODO: registers from $v0 to $a3 are not used,
-  //       reserving them for function calls.
-  enum class name
-  {
-    ZERO,
-    AT, // Reserved for assembler
-    V0,
-    V1,
-    A0,
-    A1,
-    A2,
-    A3,
-    T0,
-    T1,
-    T2,
-    T3,
-    T4,
-    T5,
-    T6,
-    T7,
-    S0,
-    S1,
-    S2,
-    S3,
-    S4,
-    S5,
-    S6,
-    S7,
-    T8,
-    T9,
-    K1, // Reserved for kernel
-    K2, // Reserved for kernel
-    GP, // Global pointer
-    SP, // Stack pointer
-    FP, // Frame pointer
-    RA  // Return address
-  };
-
-  constexpr
-  register_t() noexcept : register_t{ name::T0 }
+  MIPSTranspiler(std::unique_ptr<ir::Function> function, std::vector<Diagnostic>& diagnostics,
+                 Peephole peephole = Peephole{}, bool buffer_output = true)
+      : m_function{ std::move(function) }, m_diagnostics{ diagnostics }, m_peephole{ peephole },
+        m_buffer_output{ buffer_output }
   {
   }
 
-  constexpr
-  register_t(name name) noexcept : name_{ name }
+  /// Append the assembly of the function to `out`.
+  void Transpile(fmt::memory_buffer& out);
+  /// Append the function to `out` as an executable, see Assembler.
+  void Assemble(fmt::memory_buffer& out);
+
+  /// The number of instructions emitted by Transpile or Assemble, before pseudo-instructions are expanded.
+  [[nodiscard]] int
+  instruction_count() const noexcept
   {
+    return m_instruction_count;
   }
 
-  constexpr
-  register_t(int value) noexcept : name_{ static_cast<name>(value) }
+  /// The number of values the register allocator put in memory.
+  [[nodiscard]] int
+  spilled_count() const noexcept
   {
+    return m_allocator ? m_allocator->spilled() : 0;
   }
 
-  [[nodiscard]] constexpr operator int() const noexcept { return static_cast<int>(name_); }
-
-  [[nodiscard]] operator std::string() const noexcept
+  [[nodiscard]] const Peephole&
+  peephole() const noexcept
   {
-    switch (name_)
-      {
-      case name::ZERO:
-        return "$zero";
-      case name::T0:
-        return "$t0";
-      case name::T1:
-        return "$t1";
-      case name::T2:
-        return "$t2";
-      case name::T3:
-        return "$t3";
-      case name::T4:
-        return "$t4";
-      case name::T5:
-        return "$t5";
-      case name::T6:
-        return "$t6";
-      case name::T7:
-        return "$t7";
-      case name::S0:
-        return "$s0";
-      case name::S1:
-        return "$s1";
-      case name::S2:
-        return "$s2";
-      case name::S3:
-        return "$s3";
-      case name::S4:
-        return "$s4";
-      case name::S5:
-        return "$s5";
-      case name::S6:
-        return "$s6";
-      case name::S7:
-        return "$s7";
-      case name::T8:
-        return "$t8";
-      case name::T9:
-        return "$t9";
-      case name::SP:
-        return "$sp";
-      case name::A0:
-        return "$a0";
-      case name::V0:
-        return "$v0";
-      default:
-        assert(false && "unhandled register to std::string conversion");
-      }
+    return m_peephole;
   }
 
 private:
-  name name_;
-};
-
-class Scope;
-
-class MIPSTranspiler final : public ExprVisitor, public StmtVisitor
-{
-public:
-  MIPSTranspiler(std::unique_ptr<ast::Program> program, std::vector<Diagnostic>& diagnostics)
-      : m_program{ program.release() }, m_diagnostics{ diagnostics }
+  /// Select, allocate and clean up the instructions of the function.
+  void generate();
+  /// Label the blocks that are not only reached by falling through, and the string literals.
+  void analyze();
+  /// Add the string literals to the data section. A literal that ends another one is not repeated, the
+  /// longer one runs on into it.
+  void lay_out_strings();
+
+  void select(ir::BasicBlock&);
+  void select(ir::Instruction&);
+  /// Select the cheapest tile covering the arithmetic or comparison `instruction`, see tiles.
+  void select_tiled(ir::Instruction&);
+  /// Multiply `value` by `factor`, whose magnitude is a power of two or one away from it, with shifts and
+  /// additions.
+  void select_multiplication(ir::Instruction&, const ir::Instruction* value, int factor);
+  /// Select with movn or movz, which move a register over the result depending on the condition.
+  void select_conditional_move(ir::Instruction&);
+  void select_print(ir::Instruction&);
+  /// Return true if the function prints often enough for the output buffer to pay off.
+  [[nodiscard]] bool prints_often() const noexcept;
+  /// Emit the routines of the runtime that buffers the output.
+  void emit_runtime();
+  void select_terminator(ir::BasicBlock&, ir::Instruction&);
+  /// Branch to `label` if `comparison` evaluates to `when`.
+  void select_branch(const ir::Instruction& comparison, bool when, int label);
+
+  /// Copy the values the phis of the successors of `block` select when coming from it.
+  void copy_to_phis(ir::BasicBlock& block);
+  /// Return true if copy_to_phis has anything to copy at the end of `block`.
+  [[nodiscard]] bool copies_to_phis(const ir::BasicBlock& block) const noexcept;
+
+  /// Return a register holding `value`, loading or materializing it in a scratch register if needed.
+  [[nodiscard]] RegisterPool::Handle use(const ir::Instruction* value);
+  /// Return the register the result of `value` must be computed in.
+  [[nodiscard]] register_t define(const ir::Instruction* value) const noexcept;
+  /// Store the result of `value` if it lives in memory.
+  void store(const ir::Instruction* value);
+  /// Load or materialize `value` into `reg`.
+  void load(register_t reg, const ir::Instruction* value);
+  /// Materialize `value` into `reg`, with lui and ori when it does not fit in 16 bits.
+  void load_constant(register_t reg, int value);
+  /// Return the number of instructions load_constant materializes `value` in.
+  [[nodiscard]] static int constant_cost(int value) noexcept;
+
+  [[nodiscard]] const Location&
+  location(const ir::Instruction* value) const noexcept
   {
+    return m_allocator->location(*value);
   }
 
-  ~MIPSTranspiler();
+  /// Return the offset from $gp of the slot `where` was spilled to.
+  [[nodiscard]] static int slot_offset(const Location& where) noexcept;
+
+  [[nodiscard]] static bool fits_immediate(int value) noexcept;
 
-  class RuntimeException
+  /// What an operand of a tile matches.
+  enum class Pattern : uint8_t
   {
+    /// Any value, loaded into a register if it is not in one.
+    REGISTER,
+    /// The constant 0.
+    ZERO,
+    /// A constant that fits a signed 16-bit immediate.
+    SIGNED_IMMEDIATE,
+    /// A constant whose negation fits a signed 16-bit immediate.
+    NEGATED_IMMEDIATE,
+    /// A constant that fits a signed 16-bit immediate once incremented.
+    SUCCESSOR_IMMEDIATE,
+    /// A constant that fits an unsigned 16-bit immediate.
+    UNSIGNED_IMMEDIATE,
+    /// A constant whose magnitude is a power of two.
+    POWER_OF_TWO,
+    /// A constant whose magnitude is one away from a power of two.
+    NEAR_POWER_OF_TWO,
   };
 
-  // TODO: Check for stack overflow.
-  class Stack
+  /**
+   * A sequence of instructions computing an IR operation on operands that
+   * match its patterns. It takes `cost` instructions, not counting the ones
+   * loading operands into registers.
+   */
+  struct Tile
   {
-  public:
-    Stack(MIPSTranspiler& transpiler) : m_transpiler{ transpiler } {}
-
-    [[nodiscard]] int push() noexcept;
-    void pop() noexcept;
-
-  private:
-    int size_ = {};
-    MIPSTranspiler& m_transpiler;
+    ir::Opcode op;
+    Pattern lhs;
+    Pattern rhs;
+    int cost;
+    void (*emit)(MIPSTranspiler&, ir::Instruction&, const ir::Instruction* lhs, const ir::Instruction* rhs);
   };
 
-  std::string Transpile();
-
-  void VisitProgram(ast::Program&) override;
-  void VisitLetStmt(ast::LetStmt&) override;
-  void VisitIfStmt(ast::IfStmt&) override;
-  void VisitForStmt(ast::ForStmt&) override;
-  void VisitPrintStmt(ast::PrintStmt&) override;
-  void VisitExprStmt(ast::ExprStmt&) override;
-
-  std::any VisitNumber(ast::Number&) override;
-  std::any VisitString(ast::String&) override;
-  std::any VisitIdentifier(ast::Identifier&) override;
-  std::any VisitAddExpr(ast::AddExpr&) override;
-  std::any VisitSubExpr(ast::SubExpr&) override;
-  std::any VisitMultExpr(ast::MultExpr&) override;
-  std::any VisitAssignExpr(ast::AssignExpr&) override;
-  std::any VisitComparisonExpr(ast::ComparisonExpr&) override;
-
-private:
-  friend class Scope;
-
-  [[nodiscard]] register_t find_register() noexcept;
-  void release_register(register_t reg);
+  /// The tiles arithmetic and comparisons are selected from. A new instruction is used wherever a tile
+  /// added for it is cheaper than the others.
+  static const std::vector<Tile> tiles;
 
-  [[nodiscard]] RuntimeException undeclared_variable_error(ast::Identifier&);
+  /// Return true if `value` matches `pattern`.
+  [[nodiscard]] static bool matches(Pattern pattern, const ir::Instruction* value) noexcept;
+  /// Return the number of instructions it takes to make `value` an operand matching `pattern`.
+  [[nodiscard]] int operand_cost(Pattern pattern, const ir::Instruction* value) const noexcept;
 
-  void emit(const std::string& s) noexcept;
-  void emit(const Instruction& instruction) noexcept;
+  void emit(const Instruction& instruction);
 
   template <typename Inst, typename... Args>
   void
-  emit(Args&&... args) noexcept
+  emit(Args&&... args)
   {
     emit(Inst(args...));
   }
@@ -209,74 +205,73 @@ private:
     return m_diagnostics;
   }
 
-  [[nodiscard]] Stack&
-  stack() noexcept
-  {
-    return m_stack;
-  }
+  int generate_label() noexcept;
 
-  [[nodiscard]] Scope&
-  current_scope() const noexcept
-  {
-    return *m_scope;
-  }
+  [[nodiscard]] bool is_next(const ir::BasicBlock& block, const ir::BasicBlock* successor) const noexcept;
+  /// Return the label a jump to `block` goes to.
+  [[nodiscard]] int label(const ir::BasicBlock* block) const noexcept;
 
-  void enter_scope() noexcept;
-  void leave_scope() noexcept;
-
-  std::string generate_label(const std::string& prefix = "");
-
-  ast::Program* m_program;
-  std::vector<Diagnostic>& m_diagnostics;
-
-  std::string m_result = {};
-  std::bitset<register_t::size> m_registers = register_t::min_value;
-  Scope* m_scope = nullptr;
-  Stack m_stack = { *this };
-  int m_label_count = 0;
-  std::unordered_map<std::string, const std::string&> m_string_literals = {};
-};
-
-class Scope
-{
-public:
-  Scope(MIPSTranspiler& transpiler) : Scope{ nullptr, transpiler } {}
+  /// Return true if `block` does nothing but jump to its successor.
+  [[nodiscard]] bool is_forwarder(const ir::BasicBlock& block) const noexcept;
 
-  Scope(Scope* enclosing, MIPSTranspiler& transpiler) : m_enclosing{ enclosing }, m_transpiler{ transpiler }
+  /// Return the block a jump to `block` really goes to, past the blocks that only jump on.
+  [[nodiscard]] const ir::BasicBlock*
+  target(const ir::BasicBlock* block) const noexcept
   {
+    return m_targets[block->id];
   }
 
-  ~Scope()
+  [[nodiscard]] bool
+  is_emitted(const ir::BasicBlock& block) const noexcept
   {
-    for (decltype(m_variables)::size_type i = 0; i < m_variables.size(); i++)
-      {
-        m_transpiler.stack().pop();
-      }
+    return target(&block) == &block;
   }
 
-  [[nodiscard]] Scope*
-  enclosing() noexcept
-  {
-    return m_enclosing;
-  }
-
-  /**
-   * Declare and initialize a variable.
-   */
-  void declare_and_initialize(const ast::Identifier& identifier, register_t rs) noexcept;
-
-  /**
-   * Find a variable in the current scope and return its offset into the stack.
-   *
-   * If the variable is not found a runtime exception is thrown.
-   *
-   */
-  int find_variable(const ast::Identifier& identifier) const noexcept;
+  std::unique_ptr<ir::Function> m_function;
+  std::vector<Diagnostic>& m_diagnostics;
 
-private:
-  Scope* m_enclosing;
-  MIPSTranspiler& m_transpiler;
-  std::unordered_map<std::string, int> m_variables = {};
+  /// The instructions selected so far, cleaned up by the peephole pass before they are printed.
+  std::vector<Instruction> m_instructions = {};
+  Peephole m_peephole;
+  int m_label_count = 0;
+  int m_instruction_count = 0;
+
+  /// The labels of the blocks and string literals.
+  std::vector<int> m_block_labels = {};
+  std::vector<int> m_string_labels = {};
+  /// The objects of the data section.
+  std::vector<Datum> m_data = {};
+  std::vector<bool> m_needs_label = {};
+  /// The position of every emitted block in the layout.
+  std::vector<std::size_t> m_layout = {};
+  /// The number of blocks emitted.
+  std::size_t m_laid_out = 0;
+  /// The block jumps to every block go to, see target.
+  std::vector<const ir::BasicBlock*> m_targets = {};
+  /// The label of the epilogue, or -1 if nothing jumps to it.
+  int m_exit_label = -1;
+
+  std::unique_ptr<RegisterAllocator> m_allocator = {};
+  /// The registers operands are loaded into when they are not in one.
+  RegisterPool m_scratch{ RegisterAllocator::first_scratch, RegisterAllocator::second_scratch };
+
+  /// The syscall service currently in $v0, or -1 if unknown.
+  int m_service = -1;
+
+  bool m_buffer_output;
+  /// The labels of the runtime, if the prints go through it, and the offsets from $gp of its data.
+  struct
+  {
+    int flush = -1;
+    int put_int = -1;
+    int put_string = -1;
+    int put_char = -1;
+    int saved_ra = 0;
+    int buffer = 0;
+    int digits = 0;
+  } m_runtime = {};
+  /// The size of the small data area.
+  int m_small_data_size = 0;
 };
 
 }
@@ -4,7 +4,9 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Lexer.hpp"
@@ -32,6 +34,9 @@ public:
   {
   };
 
+  /// Programs with fewer tokens than this are not worth parsing in parallel.
+  static constexpr std::size_t parallel_threshold = 16384;
+
   Parser(std::vector<Token> tokens, std::vector<Diagnostic>& diagnostics)
       : m_tokens{ tokens }, m_diagnostics{ diagnostics }
   {
@@ -78,6 +83,13 @@ public:
 
   std::unique_ptr<ast::Program> Parse();
 
+  /// Parse the program splitting its top-level statements across `jobs` threads.
+  ///
+  /// Statements are merged back in source order. Small or unbalanced programs,
+  /// and programs with errors, are parsed sequentially, so the diagnostics are
+  /// the ones a sequential parse reports.
+  std::unique_ptr<ast::Program> ParseParallel(unsigned jobs = std::thread::hardware_concurrency());
+
   friend ast::Expr* parse_integer(Parser&, Token);
   friend ast::Expr* parse_string(Parser&, Token);
   friend ast::Expr* parse_identifier(Parser&, Token);
@@ -85,10 +97,19 @@ public:
   friend ast::Expr* parse_binary_operator(Parser&, Token, ast::Expr*);
 
 private:
+  using TokenRange = std::pair<std::vector<Token>::size_type, std::vector<Token>::size_type>;
+
+  /// Find the token ranges of the top-level statements, or nullopt if the
+  /// program is not well balanced and must be parsed sequentially.
+  [[nodiscard]] std::optional<std::vector<TokenRange> > top_level_statements() const noexcept;
+
   [[nodiscard]] ast::Stmt* parse_stmt();
   [[nodiscard]] ast::LetStmt* parse_let_stmt();
   [[nodiscard]] ast::IfStmt* parse_if_stmt();
   [[nodiscard]] ast::ForStmt* parse_for_stmt();
+  /// Split a range like "0..n" into the number or variable on each side of its '..'.
+  [[nodiscard]] std::pair<std::unique_ptr<ast::Expr>, std::unique_ptr<ast::Expr> >
+  parse_range(const Token& range);
   [[nodiscard]] ast::PrintStmt* parse_print_stmt();
   [[nodiscard]] ast::Expr* parse_expr(int precedence = 0);
 
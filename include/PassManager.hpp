@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ir.hpp"
+
+namespace cat
+{
+
+/// A transformation of a function in SSA form.
+class Pass
+{
+public:
+  virtual ~Pass() {}
+
+  [[nodiscard]] virtual const char* name() const noexcept = 0;
+
+  /// Transform `function`, returning true if it changed.
+  virtual bool Run(ir::Function& function) = 0;
+};
+
+/**
+ * Run a pipeline of passes over a function.
+ *
+ * Passes enable each other, for example propagating a constant into a
+ * condition makes a branch dead, so the pipeline is repeated until it no
+ * longer changes the function.
+ */
+class PassManager
+{
+public:
+  /// The number of times the pipeline is repeated at most.
+  static constexpr int max_iterations = 8;
+
+  template <typename P, typename... Args>
+  void
+  add(Args&&... args)
+  {
+    m_passes.push_back(std::make_unique<P>(std::forward<Args>(args)...));
+  }
+
+  void Run(ir::Function& function);
+
+  /// The number of runs in which every pass changed the function, in pipeline order.
+  [[nodiscard]] std::vector<std::pair<const char*, int> > changes() const;
+
+private:
+  std::vector<std::unique_ptr<Pass> > m_passes = {};
+  std::vector<int> m_changes = {};
+};
+
+}
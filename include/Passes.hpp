@@ -0,0 +1,216 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "PassManager.hpp"
+
+namespace cat
+{
+
+/**
+ * Find the values that are the same constant whichever way the program
+ * goes and the branches that can only go one way, assuming every value
+ * is constant and every block unreachable until shown otherwise. Unlike
+ * constant propagation, a phi only meets the values coming in along the
+ * edges that can be taken, so a variable assigned the same constant on
+ * every path that runs stays constant past loops and if statements. The
+ * values become constants, and the branches become jumps, so the phis
+ * whose remaining operands are the same value are left to copy
+ * propagation.
+ */
+class SparseConditionalConstantPropagation final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "sparse conditional constant propagation";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+/**
+ * Evaluate instructions whose operands are constants, apply algebraic
+ * identities, and turn branches on constants into jumps and selects on
+ * them into the value they select.
+ */
+class ConstantPropagation final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "constant propagation";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+/// Replace phis whose operands are all the same value, other than the phi itself, by the value they copy.
+class CopyPropagation final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "copy propagation";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+/**
+ * Replace instructions that compute the same value as an instruction that
+ * dominates them by that instruction.
+ */
+class CommonSubexpressionElimination final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "common subexpression elimination";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+/**
+ * Merge prints of constants, characters and string literals that run one
+ * after the other into a single print of a new string literal, so the
+ * program makes one system call where it made several.
+ */
+class PrintCoalescing final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "print coalescing";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+/**
+ * Turn small if statements into straight-line code: when both branches
+ * only compute values without side effects and then meet again, their
+ * instructions run before the branch, and the phis where they meet become
+ * selects on the condition of the branch. Additions and subtractions can
+ * trap, so branches computing them are left alone.
+ */
+class IfConversion final : public Pass
+{
+public:
+  /// Describe every branch removed in `remarks`, if not nullptr.
+  explicit IfConversion(std::vector<std::string>* remarks = nullptr) : m_remarks{ remarks } {}
+
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "if conversion";
+  }
+
+  bool Run(ir::Function&) override;
+
+private:
+  std::vector<std::string>* m_remarks;
+};
+
+/**
+ * Move the instructions of a loop whose operands are defined outside of it
+ * to its preheader, so they run once rather than on every iteration.
+ * Additions and subtractions that may trap are only moved out of the
+ * blocks that run on every iteration, and only when nothing is printed
+ * before them in the iteration, so they do not trap any sooner.
+ */
+class LoopInvariantCodeMotion final : public Pass
+{
+public:
+  /// Describe every loop code is moved out of in `remarks`, if not nullptr.
+  explicit LoopInvariantCodeMotion(std::vector<std::string>* remarks = nullptr) : m_remarks{ remarks } {}
+
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "loop invariant code motion";
+  }
+
+  bool Run(ir::Function&) override;
+
+private:
+  std::vector<std::string>* m_remarks;
+};
+
+/**
+ * Unroll loops made of a single block that count from one constant to
+ * another, the shape for loops are built in.
+ *
+ * Loops whose unrolled body stays under a size limit are replaced by a copy
+ * of the body per iteration, which constant propagation then specializes.
+ * The others run several iterations per trip around the loop, with the
+ * iterations left over run before it, so only one in so many iterations
+ * tests whether the loop is done.
+ */
+class LoopUnrolling final : public Pass
+{
+public:
+  /**
+   * Run up to `factor` iterations per trip around a loop that is not
+   * unrolled fully, and describe every loop unrolled in `remarks`, if not
+   * nullptr.
+   */
+  explicit LoopUnrolling(int factor, std::vector<std::string>* remarks = nullptr)
+      : m_factor{ factor }, m_remarks{ remarks }
+  {
+  }
+
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "loop unrolling";
+  }
+
+  bool Run(ir::Function&) override;
+
+private:
+  int m_factor;
+  std::vector<std::string>* m_remarks;
+  /// The headers of the loops already unrolled, which must not be unrolled again.
+  std::unordered_set<int> m_unrolled = {};
+};
+
+/**
+ * Remove instructions whose value is never used by an instruction with side
+ * effects, and the string literals that are no longer used. Additions and
+ * subtractions that may trap are kept, so that they still trap.
+ */
+class DeadInstructionElimination final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "dead instruction elimination";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+/// Remove unreachable blocks and merge blocks that always run one after the other.
+class CFGSimplification final : public Pass
+{
+public:
+  [[nodiscard]] const char*
+  name() const noexcept override
+  {
+    return "control flow simplification";
+  }
+
+  bool Run(ir::Function&) override;
+};
+
+}
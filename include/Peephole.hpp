@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <vector>
+
+#include "Instruction.hpp"
+
+namespace cat
+{
+
+/**
+ * Clean up a stream of MIPS instructions by looking at two neighbouring
+ * instructions at a time.
+ *
+ * The stream is rebuilt one instruction at a time, and the rules are
+ * applied to the end of the rebuilt stream until none of them fires, so a
+ * rewrite can enable another one with the instruction before it. Every rule
+ * can be turned off on its own, and counts how many times it fired.
+ */
+class Peephole final
+{
+public:
+  enum class Rule
+  {
+    /// move r, r and addi r, r, 0 do nothing.
+    REDUNDANT_MOVE,
+    /// sw r, o(b) followed by lw s, o(b) loads the value of r.
+    STORE_LOAD,
+    /// li r, c followed by move d, r loads c into d directly when r is overwritten before it is read again.
+    CONSTANT_MOVE,
+    /// Two adjustments of $sp in a row are one.
+    STACK_ADJUSTMENT,
+    /// A jump or a branch to the label right after it does nothing.
+    JUMP_TO_NEXT,
+  };
+
+  static constexpr int rule_count = 5;
+
+  explicit Peephole(bool enabled = true) noexcept
+  {
+    if (enabled)
+      m_enabled.set();
+  }
+
+  [[nodiscard]] static const char* name(Rule rule) noexcept;
+
+  void
+  enable(Rule rule, bool enabled = true) noexcept
+  {
+    m_enabled.set(static_cast<int>(rule), enabled);
+  }
+
+  [[nodiscard]] bool
+  is_enabled(Rule rule) const noexcept
+  {
+    return m_enabled.test(static_cast<int>(rule));
+  }
+
+  /// The number of times `rule` fired.
+  [[nodiscard]] int
+  hits(Rule rule) const noexcept
+  {
+    return m_hits[static_cast<int>(rule)];
+  }
+
+  /// Rewrite `instructions`, returning true if it changed.
+  bool Run(std::vector<Instruction>& instructions);
+
+private:
+  /// Apply the first rule that fires on the end of `result`, returning true if one did.
+  bool apply(std::vector<Instruction>& result, const std::vector<Instruction>& instructions,
+             std::size_t next);
+  /// Return true if `reg` is written before it is read from `instructions[next]` on.
+  [[nodiscard]] static bool is_dead(register_t reg, const std::vector<Instruction>& instructions,
+                                    std::size_t next) noexcept;
+  void hit(Rule rule) noexcept;
+
+  std::bitset<rule_count> m_enabled = {};
+  std::array<int, rule_count> m_hits = {};
+};
+
+}
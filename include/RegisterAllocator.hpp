@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "ir.hpp"
+#include "register.hpp"
+
+namespace cat
+{
+
+/// Where a value lives for its whole lifetime.
+struct Location
+{
+  enum class Kind
+  {
+    /// The value is never used, is rematerialized where it is used, or is a
+    /// comparison tested directly by the branch after it.
+    NONE,
+    REGISTER,
+    /// The value was spilled to a slot of the spill area in memory.
+    MEMORY
+  };
+
+  Kind kind = Kind::NONE;
+  /// The register number, or the offset of the slot from the start of the spill area.
+  int index = 0;
+};
+
+/**
+ * Assign a register or a memory slot to every value of a function.
+ *
+ * Instructions are numbered in layout order and every value gets the
+ * interval from its definition to its last use, widened to the blocks it
+ * is live through. Intervals are then allocated by the linear scan of
+ * Poletto and Sarkar: when no register is free, the interval that ends last
+ * lives in memory for its whole lifetime. Memory slots are then assigned
+ * by a second scan over the spilled intervals, so that values whose
+ * lifetimes do not overlap, like the ones of the two branches of an if,
+ * share a slot.
+ *
+ * Instructions read their operands before writing their result, so a value
+ * can take the register of an operand used for the last time by the
+ * instruction defining it. The copies to the phis of a block happen at the
+ * position of the terminator of every predecessor.
+ *
+ * Values are hinted towards the register of the values they are copied
+ * from or to, so that phis usually share the register of their operands
+ * and copies disappear. A value that is only printed, by the next print
+ * after it, is computed directly in $a0. A comparison that is only tested
+ * by the branch right after it is left to the branch, and its operands are
+ * kept until then.
+ *
+ * $t8 and $t9 are never allocated: they are the scratch registers the
+ * selector loads spilled values and constants into.
+ */
+class RegisterAllocator final
+{
+public:
+  static constexpr register_t first_scratch{ register_t::name::T8 };
+  static constexpr register_t second_scratch{ register_t::name::T9 };
+  /// The number of registers values are allocated to, from $t0 to $s7.
+  static constexpr int allocatable = first_scratch - register_t::min_value;
+
+  /// The function must not have critical edges.
+  explicit RegisterAllocator(const ir::Function& function);
+
+  [[nodiscard]] const Location&
+  location(const ir::Instruction& value) const noexcept
+  {
+    return m_locations[value.id];
+  }
+
+  /// The size of the area of memory holding the spilled values.
+  [[nodiscard]] int
+  spill_area_size() const noexcept
+  {
+    return m_spill_area_size;
+  }
+
+  /// The number of values that live in memory.
+  [[nodiscard]] int
+  spilled() const noexcept
+  {
+    return m_spilled;
+  }
+
+private:
+  struct Interval
+  {
+    const ir::Instruction* value;
+    std::size_t start;
+    std::size_t end;
+  };
+
+  void number(const ir::Function& function);
+  /// Put the values that are only printed in $a0, and find the comparisons folded into branches.
+  void precolor(const ir::Function& function);
+  void build_intervals(const ir::Function& function);
+  void add_hints(const ir::Function& function);
+  void scan();
+  void spill(const Interval& interval);
+  /// Assign memory slots to the spilled intervals.
+  void assign_slots();
+
+  std::vector<Location> m_locations = {};
+  /// The position of the first and last instructions of every block.
+  std::vector<std::size_t> m_block_start = {};
+  std::vector<std::size_t> m_block_end = {};
+  /// The position of every instruction.
+  std::vector<std::size_t> m_positions = {};
+  std::vector<Interval> m_intervals = {};
+  std::vector<Interval> m_spilled_intervals = {};
+  /// Whether every value is a comparison folded into the branch after it.
+  std::vector<bool> m_folded = {};
+  /// The values whose register every value would rather share.
+  std::vector<std::vector<const ir::Instruction*> > m_hints = {};
+  int m_spill_area_size = 0;
+  int m_spilled = 0;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "diagnostic.hpp"
+#include "expr_visitor.hpp"
+#include "stmt_visitor.hpp"
+
+namespace cat
+{
+
+/**
+ * Interns identifier names into dense 32-bit symbol ids.
+ *
+ * The names are views into the source code, which must outlive the table.
+ */
+class SymbolTable
+{
+public:
+  using symbol_t = std::uint32_t;
+
+  /// Return the symbol for `name`, allocating a new one if it was never seen.
+  [[nodiscard]] symbol_t intern(std::string_view name);
+
+  [[nodiscard]] std::size_t
+  size() const noexcept
+  {
+    return m_symbols.size();
+  }
+
+private:
+  std::unordered_map<std::string_view, symbol_t> m_symbols = {};
+};
+
+/**
+ * Resolve every identifier in a program to the stack slot of the variable
+ * it refers to, so that code generation does not need to look up names.
+ *
+ * Slots are allocated in declaration order and released when the scope that
+ * declared them ends, mirroring the order in which variables are pushed onto
+ * and popped from the stack.
+ */
+class Resolver final : public ExprVisitor, public StmtVisitor
+{
+public:
+  Resolver(std::vector<Diagnostic>& diagnostics) : m_diagnostics{ diagnostics } {}
+
+  /// Resolve the program, returning false if there were undeclared variables.
+  bool Resolve(ast::Program&);
+
+  /// The maximum number of slots that are live at the same time.
+  [[nodiscard]] int
+  max_slots() const noexcept
+  {
+    return m_max_slots;
+  }
+
+  void VisitProgram(ast::Program&) override;
+  void VisitLetStmt(ast::LetStmt&) override;
+  void VisitIfStmt(ast::IfStmt&) override;
+  void VisitForStmt(ast::ForStmt&) override;
+  void VisitPrintStmt(ast::PrintStmt&) override;
+  void VisitExprStmt(ast::ExprStmt&) override;
+
+  std::any VisitNumber(ast::Number&) override;
+  std::any VisitString(ast::String&) override;
+  std::any VisitIdentifier(ast::Identifier&) override;
+  std::any VisitAddExpr(ast::AddExpr&) override;
+  std::any VisitSubExpr(ast::SubExpr&) override;
+  std::any VisitMultExpr(ast::MultExpr&) override;
+  std::any VisitAssignExpr(ast::AssignExpr&) override;
+  std::any VisitComparisonExpr(ast::ComparisonExpr&) override;
+
+private:
+  void enter_scope() noexcept;
+  void leave_scope() noexcept;
+
+  /// Allocate a slot for a new variable and bind the identifier to it.
+  void declare(ast::Identifier&);
+
+  void undeclared_variable_error(ast::Identifier&);
+
+  std::vector<Diagnostic>& m_diagnostics;
+
+  SymbolTable m_symbols = {};
+  /// For every symbol, the slots of the variables that are currently bound to it.
+  std::vector<std::vector<int> > m_bindings = {};
+  /// The symbols of the live variables, indexed by slot.
+  std::vector<SymbolTable::symbol_t> m_slots = {};
+  /// The number of live slots at the start of every open scope.
+  std::vector<std::size_t> m_scopes = {};
+  int m_max_slots = 0;
+  bool m_had_error = false;
+};
+
+}
@@ -2,6 +2,7 @@
 
 #include <any>
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -37,7 +38,11 @@ public:
   void Accept(StmtVisitor&) override;
 
   void add_stmt(Stmt* stmt) noexcept;
+
+  /// Move the statements of `other` to the end of this program.
+  void take_stmts(Program& other) noexcept;
   [[nodiscard]] std::vector<Stmt*> stmts() const noexcept;
+  [[nodiscard]] std::vector<Stmt*>& stmts() noexcept;
 
 private:
   std::vector<Stmt*> stmts_;
@@ -53,8 +58,12 @@ public:
   void Accept(StmtVisitor&) override;
 
   [[nodiscard]] const Identifier& identifier() const noexcept;
+  [[nodiscard]] Identifier& identifier() noexcept;
   [[nodiscard]] Expr& value() const noexcept;
 
+  /// Replace the value without deleting the previous one.
+  void set_value(Expr* value) noexcept;
+
 private:
   Identifier* identifier_;
   Expr* value_;
@@ -78,30 +87,51 @@ public:
     return m_condition;
   }
 
+  /// Replace the condition without deleting the previous one.
+  void
+  set_condition(Expr* condition) noexcept
+  {
+    m_condition = condition;
+  }
+
   [[nodiscard]] std::vector<Stmt*>
   if_branch() const noexcept
   {
     return m_if_branch;
   }
 
+  [[nodiscard]] std::vector<Stmt*>&
+  if_branch() noexcept
+  {
+    return m_if_branch;
+  }
+
   [[nodiscard]] std::vector<Stmt*>
   else_branch() const noexcept
   {
     return m_else_branch;
   }
 
+  [[nodiscard]] std::vector<Stmt*>&
+  else_branch() noexcept
+  {
+    return m_else_branch;
+  }
+
 private:
   Expr* m_condition;
   std::vector<Stmt*> m_if_branch;
   std::vector<Stmt*> m_else_branch;
 };
 
+/// A loop over the integers from `from` up to, but not including, `to`.
 class ForStmt final : public Stmt
 {
 public:
-  ForStmt(std::unique_ptr<Expr> ident, std::unique_ptr<Expr> range,
+  ForStmt(std::unique_ptr<Expr> ident, std::unique_ptr<Expr> from, std::unique_ptr<Expr> to,
           std::vector<std::unique_ptr<Stmt> >&& stmts)
-      : m_loop_var{ std::move(ident) }, m_range{ std::move(range) }, m_stmts{ std::move(stmts) }
+      : m_loop_var{ std::move(ident) }, m_from{ std::move(from) }, m_to{ std::move(to) },
+        m_stmts{ std::move(stmts) }
   {
   }
 
@@ -111,10 +141,18 @@ public:
     return m_loop_var;
   }
 
+  /// The first value of the loop variable, evaluated once before the loop.
+  [[nodiscard]] const std::unique_ptr<Expr>&
+  from() const noexcept
+  {
+    return m_from;
+  }
+
+  /// The bound of the loop variable, evaluated once before the loop.
   [[nodiscard]] const std::unique_ptr<Expr>&
-  range() const noexcept
+  to() const noexcept
   {
-    return m_range;
+    return m_to;
   }
 
   [[nodiscard]] const std::vector<std::unique_ptr<Stmt> >&
@@ -123,11 +161,18 @@ public:
     return m_stmts;
   }
 
+  [[nodiscard]] std::vector<std::unique_ptr<Stmt> >&
+  stmts() noexcept
+  {
+    return m_stmts;
+  }
+
   void Accept(StmtVisitor&) override;
 
 private:
   std::unique_ptr<Expr> m_loop_var;
-  std::unique_ptr<Expr> m_range;
+  std::unique_ptr<Expr> m_from;
+  std::unique_ptr<Expr> m_to;
   std::vector<std::unique_ptr<Stmt> > m_stmts;
 };
 
@@ -147,6 +192,12 @@ public:
     return m_exprs;
   }
 
+  [[nodiscard]] std::vector<Expr*>&
+  exprs() noexcept
+  {
+    return m_exprs;
+  }
+
 private:
   std::vector<Expr*> m_exprs;
 };
@@ -230,7 +281,32 @@ public:
     return token_.lexeme();
   }
 
+  /// The interned symbol for this identifier's name.
+  [[nodiscard]] std::uint32_t
+  symbol() const noexcept
+  {
+    return m_symbol;
+  }
+
+  /// The stack slot of the variable this identifier refers to, or -1 if it is unresolved.
+  [[nodiscard]] int
+  slot() const noexcept
+  {
+    return m_slot;
+  }
+
+  void
+  resolve(std::uint32_t symbol, int slot) noexcept
+  {
+    m_symbol = symbol;
+    m_slot = slot;
+  }
+
   std::any Accept(ExprVisitor&) override;
+
+private:
+  std::uint32_t m_symbol = 0;
+  int m_slot = -1;
 };
 
 class BinaryExpr : public Expr
@@ -271,6 +347,20 @@ public:
     return rhs_;
   }
 
+  /// Replace the left operand without deleting the previous one.
+  void
+  set_lhs(Expr* lhs) noexcept
+  {
+    lhs_ = lhs;
+  }
+
+  /// Replace the right operand without deleting the previous one.
+  void
+  set_rhs(Expr* rhs) noexcept
+  {
+    rhs_ = rhs;
+  }
+
 protected:
   Expr* lhs_;
   Expr* rhs_;
@@ -315,5 +405,9 @@ public:
   std::any Accept(ExprVisitor&) override;
 };
 
+/// Return true if evaluating `expr` has no side effects. Additions and subtractions trap on overflow, so only
+/// those of two constants whose result fits are pure.
+[[nodiscard]] bool is_pure(Expr* expr) noexcept;
+
 }
 }
@@ -1,11 +1,72 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 namespace cat
 {
 
+/// Counters collected while transpiling a program.
+struct Statistics
+{
+  /// The number of expressions simplified by constant folding.
+  int folded_expressions = 0;
+  /// The number of statements removed by dead code elimination.
+  int removed_statements = 0;
+  /// The number of if statement branches removed by dead code elimination.
+  int pruned_branches = 0;
+  /// The number of instructions that dead code elimination saved.
+  int dead_code_instructions = 0;
+  /// The number of instructions in the generated program.
+  int instructions = 0;
+  /// The number of values the register allocator kept in memory.
+  int spilled_values = 0;
+  /// The number of pipeline iterations in which each optimization pass changed the program, by pass name.
+  std::vector<std::pair<std::string, int>> pass_changes = {};
+  /// The number of times each peephole rule fired, by rule name.
+  std::vector<std::pair<std::string, int>> peephole_hits = {};
+};
+
+enum class Emit
+{
+  ASSEMBLY,
+  /// The intermediate representation code is generated from.
+  IR,
+  /// A static MIPS32 ELF executable.
+  OBJECT
+};
+
+struct Options
+{
+  /// Fold constant expressions and apply algebraic identities.
+  bool fold_constants = true;
+  /// Remove unread variables, side effect free statements and branches that never run.
+  bool eliminate_dead_code = true;
+  /// Run the optimization passes over the intermediate representation.
+  bool optimize = true;
+  /// Clean up the generated instructions with a peephole pass.
+  bool peephole = true;
+  /// Collect the output in a buffer flushed with one syscall, rather than making a syscall per print.
+  bool buffer_output = true;
+  /// The number of threads to parse top-level statements on, 1 to parse sequentially.
+  unsigned parse_jobs = 1;
+  /// The most iterations a loop that is not unrolled fully runs per trip around it, 1 to not unroll it.
+  int unroll_factor = 4;
+  Emit emit = Emit::ASSEMBLY;
+  /// Where to collect statistics about the transpilation, if anywhere.
+  Statistics* statistics = nullptr;
+  /// Where to describe the loops and branches the optimization passes transformed, if anywhere.
+  std::vector<std::string>* remarks = nullptr;
+};
+
 std::string execute(const std::string& program);
-bool transpile(const std::string& source, std::string& result, const std::string& file = "<repl>");
+/// Transpile `source` into `result`, or write the errors found in it there and return false.
+bool transpile(const std::string& source, fmt::memory_buffer& result, const std::string& file = "<repl>",
+               const Options& options = {});
+bool transpile(const std::string& source, std::string& result, const std::string& file = "<repl>",
+               const Options& options = {});
 
 }
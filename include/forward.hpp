@@ -17,6 +17,7 @@ class Expr;
 class Number;
 class String;
 class Identifier;
+class BinaryExpr;
 class AddExpr;
 class SubExpr;
 class MultExpr;
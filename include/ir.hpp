@@ -0,0 +1,177 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cat
+{
+
+namespace ir
+{
+
+enum class Opcode
+{
+  /// A 32-bit constant, held in `imm`.
+  CONST,
+  /// The address of the string literal number `imm` of the function.
+  STRING,
+  ADD,
+  SUB,
+  MUL,
+  /// Comparisons produce 1 when they hold and 0 otherwise.
+  LT,
+  LTE,
+  EQ,
+  GT,
+  GTE,
+  /// Select the second operand if the first one is not zero, or the third one otherwise.
+  SELECT,
+  /// Select the operand that corresponds to the predecessor control came from.
+  PHI,
+  /// Print the operand using the syscall service in `imm`.
+  PRINT,
+  /// Jump to the first successor.
+  JUMP,
+  /// Jump to the first successor if the operand is not zero, or to the second one otherwise.
+  BRANCH,
+  RETURN
+};
+
+[[nodiscard]] const char* opcode_as_str(Opcode) noexcept;
+
+/// Return true if `op` compares its operands, producing 0 or 1.
+[[nodiscard]] bool is_comparison(Opcode op) noexcept;
+
+/// Compute the result of a binary instruction, or nothing if it would trap.
+[[nodiscard]] std::optional<int> evaluate(Opcode, int lhs, int rhs) noexcept;
+
+class BasicBlock;
+
+/**
+ * An instruction in SSA form. Instructions that produce a result are also
+ * the value they produce, and are referred to by their operands.
+ */
+class Instruction
+{
+public:
+  Instruction(Opcode op, int id, BasicBlock* block) : op{ op }, id{ id }, block{ block } {}
+
+  /// Return true if this instruction produces a value.
+  [[nodiscard]] bool has_result() const noexcept;
+
+  /// Return true if this instruction ends a basic block.
+  [[nodiscard]] bool is_terminator() const noexcept;
+
+  /// Return true if this instruction must be kept even if its value is never used.
+  [[nodiscard]] bool has_side_effects() const noexcept;
+
+  /// Return true if this instruction may trap: an addition or subtraction not known to fit in an int.
+  [[nodiscard]] bool may_trap() const noexcept;
+
+  [[nodiscard]] std::string to_s() const;
+
+  Opcode op;
+  /// The number of the value this instruction produces, unique within its function.
+  int id;
+  BasicBlock* block;
+  std::vector<Instruction*> operands = {};
+  int imm = 0;
+};
+
+class BasicBlock
+{
+public:
+  BasicBlock(int id) : id{ id } {}
+
+  /// Return the instruction that ends this block, or nullptr if it is not terminated yet.
+  [[nodiscard]] Instruction* terminator() const noexcept;
+
+  /// Return the position of `block` in the predecessors of this block.
+  [[nodiscard]] std::size_t predecessor_index(const BasicBlock* block) const noexcept;
+
+  /// Remove `block` from the predecessors, along with its operand in every phi.
+  void remove_predecessor(const BasicBlock* block);
+
+  [[nodiscard]] std::string to_s() const;
+
+  int id;
+  /// Phis come first and the terminator last.
+  std::vector<std::unique_ptr<Instruction> > instructions = {};
+  std::vector<BasicBlock*> predecessors = {};
+  std::vector<BasicBlock*> successors = {};
+  /// The immediate dominator, computed by Function::compute_dominators.
+  BasicBlock* idom = nullptr;
+};
+
+/// A natural loop, found by Function::find_loops.
+struct Loop
+{
+  /// The block every iteration starts in, which dominates the others.
+  BasicBlock* header;
+  /// The block that jumps back to the header.
+  BasicBlock* latch;
+  /// The only block outside the loop that enters it, if it jumps nowhere else, or nullptr.
+  BasicBlock* preheader;
+  /// The blocks of the loop in reverse postorder, header first.
+  std::vector<BasicBlock*> blocks;
+};
+
+/**
+ * A function is a control flow graph of basic blocks. The first block is
+ * the entry and the order of the blocks is the order they are laid out in.
+ */
+class Function
+{
+public:
+  Function() { create_block(); }
+
+  [[nodiscard]] BasicBlock*
+  entry() const noexcept
+  {
+    return blocks.front().get();
+  }
+
+  BasicBlock* create_block();
+
+  /// Append a new instruction to the end of `block`.
+  Instruction* append(BasicBlock* block, Opcode op, std::vector<Instruction*> operands = {}, int imm = 0);
+
+  /// Insert a new phi without operands after the phis of `block`.
+  Instruction* insert_phi(BasicBlock* block);
+
+  void add_edge(BasicBlock* from, BasicBlock* to);
+
+  /**
+   * Insert an empty block on every edge from a block with several successors
+   * to a block with phis, so that the copies that implement the phis only
+   * run on the edge they belong to.
+   */
+  void split_critical_edges();
+
+  /// Replace every use of the keys of `replacements` with their values and delete the keys.
+  void replace(const std::unordered_map<Instruction*, Instruction*>& replacements);
+
+  /// Return the reachable blocks in reverse postorder.
+  [[nodiscard]] std::vector<BasicBlock*> reverse_postorder() const;
+
+  /// Compute the immediate dominator of every reachable block.
+  void compute_dominators();
+
+  /// Return true if `a` dominates `b`. Dominators must be up to date.
+  [[nodiscard]] bool dominates(const BasicBlock* a, const BasicBlock* b) const noexcept;
+  /// Return the loops with a single back edge, inner loops first. Dominators must be up to date.
+  [[nodiscard]] std::vector<Loop> find_loops() const;
+
+  [[nodiscard]] std::string to_s() const;
+
+  std::vector<std::unique_ptr<BasicBlock> > blocks = {};
+  std::vector<std::string> strings = {};
+  int value_count = 0;
+  int block_count = 0;
+};
+
+}
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cassert>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cat
+{
+
+class register_t
+{
+public:
+  static const int min_value = 8;
+  static const int max_value = 25;
+  static const int size = max_value - min_value + 1;
+
+  // TODO: registers from $v0 to $a3 are not used,
+  //       reserving them for function calls.
+  enum class name
+  {
+    ZERO,
+    AT, // Reserved for assembler
+    V0,
+    V1,
+    A0,
+    A1,
+    A2,
+    A3,
+    T0,
+    T1,
+    T2,
+    T3,
+    T4,
+    T5,
+    T6,
+    T7,
+    S0,
+    S1,
+    S2,
+    S3,
+    S4,
+    S5,
+    S6,
+    S7,
+    T8,
+    T9,
+    K1, // Reserved for kernel
+    K2, // Reserved for kernel
+    GP, // Global pointer
+    SP, // Stack pointer
+    FP, // Frame pointer
+    RA  // Return address
+  };
+
+  constexpr
+  register_t() noexcept : register_t{ name::T0 }
+  {
+  }
+
+  constexpr
+  register_t(name name) noexcept : name_{ name }
+  {
+  }
+
+  constexpr
+  register_t(int value) noexcept : name_{ static_cast<name>(value) }
+  {
+  }
+
+  [[nodiscard]] constexpr operator int() const noexcept { return static_cast<int>(name_); }
+
+  [[nodiscard]] operator std::string() const noexcept
+  {
+    switch (name_)
+      {
+      case name::ZERO:
+        return "$zero";
+      case name::T0:
+        return "$t0";
+      case name::T1:
+        return "$t1";
+      case name::T2:
+        return "$t2";
+      case name::T3:
+        return "$t3";
+      case name::T4:
+        return "$t4";
+      case name::T5:
+        return "$t5";
+      case name::T6:
+        return "$t6";
+      case name::T7:
+        return "$t7";
+      case name::S0:
+        return "$s0";
+      case name::S1:
+        return "$s1";
+      case name::S2:
+        return "$s2";
+      case name::S3:
+        return "$s3";
+      case name::S4:
+        return "$s4";
+      case name::S5:
+        return "$s5";
+      case name::S6:
+        return "$s6";
+      case name::S7:
+        return "$s7";
+      case name::T8:
+        return "$t8";
+      case name::T9:
+        return "$t9";
+      case name::SP:
+        return "$sp";
+      case name::A0:
+        return "$a0";
+      case name::V0:
+        return "$v0";
+      case name::RA:
+        return "$ra";
+      default:
+        assert(false && "unhandled register to std::string conversion");
+      }
+  }
+
+private:
+  name name_;
+};
+
+/**
+ * A set of registers lent out for the duration of a scope.
+ *
+ * A handle gives its register back to the pool when it is destroyed, so a
+ * register can not be held past the code that needs it. Handles can also
+ * wrap a register that does not belong to the pool, so that callers can
+ * treat every register the same way.
+ */
+class RegisterPool
+{
+public:
+  class Handle
+  {
+  public:
+    Handle(register_t reg) noexcept : m_register{ reg } {}
+
+    Handle(RegisterPool& pool, register_t reg) noexcept : m_pool{ &pool }, m_register{ reg } {}
+
+    Handle(Handle&& other) noexcept
+        : m_pool{ std::exchange(other.m_pool, nullptr) }, m_register{ other.m_register }
+    {
+    }
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+    Handle& operator=(Handle&&) = delete;
+
+    ~Handle()
+    {
+      if (m_pool != nullptr)
+        m_pool->release(m_register);
+    }
+
+    [[nodiscard]] operator register_t() const noexcept { return m_register; }
+
+  private:
+    RegisterPool* m_pool = nullptr;
+    register_t m_register;
+  };
+
+  RegisterPool(std::initializer_list<register_t> registers)
+      : m_registers{ registers }, m_taken(m_registers.size(), false)
+  {
+  }
+
+  /// Borrow the first free register of the pool.
+  [[nodiscard]] Handle
+  acquire() noexcept
+  {
+    for (std::size_t i = 0; i < m_registers.size(); i++)
+      if (!m_taken[i])
+        {
+          m_taken[i] = true;
+          return { *this, m_registers[i] };
+        }
+
+    assert(false && "every register of the pool is taken");
+    return { m_registers.front() };
+  }
+
+  /// Return true if no register of the pool is lent out.
+  [[nodiscard]] bool
+  all_free() const noexcept
+  {
+    for (auto taken : m_taken)
+      if (taken)
+        return false;
+    return true;
+  }
+
+private:
+  void
+  release(register_t reg) noexcept
+  {
+    for (std::size_t i = 0; i < m_registers.size(); i++)
+      if (m_registers[i] == reg)
+        m_taken[i] = false;
+  }
+
+  std::vector<register_t> m_registers;
+  std::vector<bool> m_taken;
+};
+
+}
@@ -0,0 +1,474 @@
+#include <cassert>
+#include <limits>
+
+#include "Assembler.hpp"
+
+#define ELF_HEADER_SIZE 52
+#define PROGRAM_HEADER_SIZE 32
+#define SECTION_HEADER_SIZE 40
+#define SEGMENT_ALIGNMENT 0x1000
+/// The size of the entry stub, in bytes.
+#define ENTRY_STUB_SIZE 24
+
+namespace cat
+{
+
+namespace
+{
+
+using Opcode = Instruction::Opcode;
+
+const uint32_t nop = 0;
+const int zero = static_cast<int>(register_t::name::ZERO);
+const int v0 = static_cast<int>(register_t::name::V0);
+const int gp = static_cast<int>(register_t::name::GP);
+
+uint32_t
+r_type(int rs, int rt, int rd, int shamt, int funct) noexcept
+{
+  return (rs & 0x1f) << 21 | (rt & 0x1f) << 16 | (rd & 0x1f) << 11 | (shamt & 0x1f) << 6 | (funct & 0x3f);
+}
+
+uint32_t
+i_type(int op, int rs, int rt, int immediate) noexcept
+{
+  return (op & 0x3f) << 26 | (rs & 0x1f) << 21 | (rt & 0x1f) << 16 | (immediate & 0xffff);
+}
+
+uint32_t
+j_type(int op, uint32_t address) noexcept
+{
+  return (op & 0x3f) << 26 | ((address >> 2) & 0x3ffffff);
+}
+
+bool
+fits_immediate(int32_t value) noexcept
+{
+  return value >= std::numeric_limits<int16_t>::min() && value <= std::numeric_limits<int16_t>::max();
+}
+
+bool
+is_branch(Opcode op) noexcept
+{
+  switch (op)
+    {
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BLTZ:
+    case Opcode::BGEZ:
+    case Opcode::BLEZ:
+    case Opcode::BGTZ:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/// Encode the branch `op` by `offset` words, or the branch testing the opposite condition when `inverted`.
+uint32_t
+branch(Opcode op, int rs, int rt, int32_t offset, bool inverted) noexcept
+{
+  switch (op)
+    {
+    case Opcode::BEQ:
+      return i_type(inverted ? 0x05 : 0x04, rs, rt, offset);
+    case Opcode::BNE:
+      return i_type(inverted ? 0x04 : 0x05, rs, rt, offset);
+    case Opcode::BLTZ:
+      return i_type(0x01, rs, inverted ? 0x01 : 0x00, offset);
+    case Opcode::BGEZ:
+      return i_type(0x01, rs, inverted ? 0x00 : 0x01, offset);
+    case Opcode::BLEZ:
+      return i_type(inverted ? 0x07 : 0x06, rs, 0, offset);
+    case Opcode::BGTZ:
+      return i_type(inverted ? 0x06 : 0x07, rs, 0, offset);
+    default:
+      assert(false && "not a branch");
+      return nop;
+    }
+}
+
+/// Return the bytes .asciiz would store for the source literal `literal`, without the terminator.
+std::string
+decode(const std::string& literal)
+{
+  std::string bytes{};
+
+  for (std::size_t i = 1; i + 1 < literal.size(); i++)
+    {
+      if (literal[i] != '\\' || i + 2 >= literal.size())
+        {
+          bytes += literal[i];
+          continue;
+        }
+
+      switch (auto c{ literal[++i] })
+        {
+        case 'n':
+          bytes += '\n';
+          break;
+        case 't':
+          bytes += '\t';
+          break;
+        case '0':
+          bytes += '\0';
+          break;
+        default:
+          bytes += c;
+        }
+    }
+
+  return bytes;
+}
+
+void
+put16(fmt::memory_buffer& out, uint16_t value)
+{
+  out.push_back(static_cast<char>(value & 0xff));
+  out.push_back(static_cast<char>(value >> 8));
+}
+
+void
+put32(fmt::memory_buffer& out, uint32_t value)
+{
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+void
+pad(fmt::memory_buffer& out, std::size_t start, std::size_t alignment)
+{
+  while ((out.size() - start) % alignment != 0)
+    out.push_back('\0');
+}
+
+}
+
+void
+Assembler::Assemble(fmt::memory_buffer& out)
+{
+  for (const auto& datum : m_data)
+    {
+      m_addresses[datum.label] = data_address + m_bytes.size();
+      if (datum.literal.empty())
+        m_bytes.append(datum.size, '\0');
+      else
+        {
+          m_bytes += decode(datum.literal);
+          if (datum.terminated)
+            m_bytes += '\0';
+        }
+    }
+
+  auto text_size{ layout() };
+  m_text.reserve(text_size / 4);
+
+  // The entry stub: $gp points into the small data area, and main returns to the exit system call.
+  auto main{ text_address + ENTRY_STUB_SIZE };
+  m_text.push_back(i_type(0x0f, 0, gp, global_pointer >> 16));
+  m_text.push_back(i_type(0x0d, gp, gp, global_pointer & 0xffff));
+  m_text.push_back(j_type(0x03, main));
+  m_text.push_back(nop);
+  m_text.push_back(i_type(0x09, zero, v0, 10));
+  m_text.push_back(r_type(0, 0, 0, 0, 0x0c));
+
+  auto address{ main };
+  for (std::size_t i = 0; i < m_instructions.size(); i++)
+    {
+      encode(m_instructions[i], i, address);
+      address += 4 * size(m_instructions[i], i);
+    }
+
+  assert(m_text.size() * 4 == text_size && "instruction encoded in more words than laid out");
+  write_elf(out);
+}
+
+uint32_t
+Assembler::layout()
+{
+  m_far.assign(m_instructions.size(), false);
+
+  // Making a branch far makes the code longer, which can only put other
+  // branches further from their labels, so this stops.
+  for (;;)
+    {
+      auto address{ text_address + ENTRY_STUB_SIZE };
+      for (std::size_t i = 0; i < m_instructions.size(); i++)
+        {
+          if (m_instructions[i].op == Opcode::LABEL)
+            m_addresses[m_instructions[i].imm] = address;
+          address += 4 * size(m_instructions[i], i);
+        }
+
+      auto changed{ false };
+      auto end{ address };
+
+      address = text_address + ENTRY_STUB_SIZE;
+      for (std::size_t i = 0; i < m_instructions.size(); i++)
+        {
+          const auto& instruction{ m_instructions[i] };
+          if (is_branch(instruction.op) && !m_far[i]
+              && !fits_immediate(branch_offset(address, instruction.imm)))
+            {
+              m_far[i] = true;
+              changed = true;
+            }
+          address += 4 * size(instruction, i);
+        }
+
+      if (!changed)
+        return end - text_address;
+    }
+}
+
+int
+Assembler::size(const Instruction& instruction, std::size_t index) const noexcept
+{
+  switch (instruction.op)
+    {
+    case Opcode::LABEL:
+      return 0;
+    case Opcode::LI:
+      return fits_immediate(instruction.imm) || (instruction.imm & 0xffff) == 0 ? 1 : 2;
+    case Opcode::LA:
+      return 2;
+    case Opcode::J:
+    case Opcode::JAL:
+    case Opcode::JR:
+      return 2;
+    default:
+      if (is_branch(instruction.op))
+        return m_far[index] ? 4 : 2;
+      return 1;
+    }
+}
+
+int32_t
+Assembler::branch_offset(uint32_t address, int label) const noexcept
+{
+  auto target{ m_addresses.at(label) };
+  return (static_cast<int32_t>(target) - static_cast<int32_t>(address + 4)) / 4;
+}
+
+void
+Assembler::encode(const Instruction& instruction, std::size_t index, uint32_t address)
+{
+  int rd{ instruction.rd };
+  int rs{ instruction.rs };
+  int rt{ instruction.rt };
+  auto imm{ instruction.imm };
+
+  switch (instruction.op)
+    {
+    case Opcode::LABEL:
+      break;
+    case Opcode::LI:
+      if (fits_immediate(imm))
+        m_text.push_back(i_type(0x09, zero, rd, imm));
+      else
+        {
+          m_text.push_back(i_type(0x0f, 0, rd, static_cast<uint32_t>(imm) >> 16));
+          if ((imm & 0xffff) != 0)
+            m_text.push_back(i_type(0x0d, rd, rd, imm));
+        }
+      break;
+    case Opcode::LA:
+      {
+        auto target{ m_addresses.at(imm) };
+        m_text.push_back(i_type(0x0f, 0, rd, target >> 16));
+        m_text.push_back(i_type(0x0d, rd, rd, target & 0xffff));
+        break;
+      }
+    case Opcode::MOVE:
+      m_text.push_back(r_type(rs, zero, rd, 0, 0x21));
+      break;
+    case Opcode::ADD:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x20));
+      break;
+    case Opcode::ADDU:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x21));
+      break;
+    case Opcode::SUB:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x22));
+      break;
+    case Opcode::SUBU:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x23));
+      break;
+    case Opcode::MULT:
+      m_text.push_back(r_type(rs, rt, 0, 0, 0x18));
+      break;
+    case Opcode::MFLO:
+      m_text.push_back(r_type(0, 0, rd, 0, 0x12));
+      break;
+    case Opcode::DIVU:
+      m_text.push_back(r_type(rs, rt, 0, 0, 0x1b));
+      break;
+    case Opcode::MFHI:
+      m_text.push_back(r_type(0, 0, rd, 0, 0x10));
+      break;
+    case Opcode::SLT:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x2a));
+      break;
+    case Opcode::SLTU:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x2b));
+      break;
+    case Opcode::XOR:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x26));
+      break;
+    case Opcode::MOVN:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x0b));
+      break;
+    case Opcode::MOVZ:
+      m_text.push_back(r_type(rs, rt, rd, 0, 0x0a));
+      break;
+    case Opcode::ADDI:
+      m_text.push_back(i_type(0x08, rs, rd, imm));
+      break;
+    case Opcode::SLTI:
+      m_text.push_back(i_type(0x0a, rs, rd, imm));
+      break;
+    case Opcode::SLTIU:
+      m_text.push_back(i_type(0x0b, rs, rd, imm));
+      break;
+    case Opcode::XORI:
+      m_text.push_back(i_type(0x0e, rs, rd, imm));
+      break;
+    case Opcode::ORI:
+      m_text.push_back(i_type(0x0d, rs, rd, imm));
+      break;
+    case Opcode::LUI:
+      m_text.push_back(i_type(0x0f, 0, rd, imm));
+      break;
+    case Opcode::LW:
+      m_text.push_back(i_type(0x23, rs, rd, imm));
+      break;
+    case Opcode::SW:
+      m_text.push_back(i_type(0x2b, rs, rt, imm));
+      break;
+    case Opcode::LBU:
+      m_text.push_back(i_type(0x24, rs, rd, imm));
+      break;
+    case Opcode::SB:
+      m_text.push_back(i_type(0x28, rs, rt, imm));
+      break;
+    case Opcode::SLL:
+      // The shifted register is the rt field of sll.
+      m_text.push_back(r_type(0, rs, rd, imm, 0x00));
+      break;
+    case Opcode::J:
+      m_text.push_back(j_type(0x02, m_addresses.at(imm)));
+      m_text.push_back(nop);
+      break;
+    case Opcode::JAL:
+      m_text.push_back(j_type(0x03, m_addresses.at(imm)));
+      m_text.push_back(nop);
+      break;
+    case Opcode::JR:
+      m_text.push_back(r_type(rs, 0, 0, 0, 0x08));
+      m_text.push_back(nop);
+      break;
+    case Opcode::SYSCALL:
+      m_text.push_back(r_type(0, 0, 0, 0, 0x0c));
+      break;
+    default:
+      if (!m_far[index])
+        {
+          m_text.push_back(branch(instruction.op, rs, rt, branch_offset(address, imm), false));
+          m_text.push_back(nop);
+        }
+      else
+        {
+          // Skip over a jump to the label when the condition does not hold.
+          m_text.push_back(branch(instruction.op, rs, rt, 3, true));
+          m_text.push_back(nop);
+          m_text.push_back(j_type(0x02, m_addresses.at(imm)));
+          m_text.push_back(nop);
+        }
+    }
+}
+
+void
+Assembler::write_elf(fmt::memory_buffer& out) const
+{
+  const std::string names{ std::string{ '\0' } + ".text" + '\0' + ".sbss" + '\0' + ".data" + '\0' + ".shstrtab"
+                           + '\0' };
+  const uint32_t text_name{ 1 };
+  const uint32_t small_data_name{ text_name + 6 };
+  const uint32_t data_name{ small_data_name + 6 };
+  const uint32_t names_name{ data_name + 6 };
+
+  auto start{ out.size() };
+  auto text_offset{ static_cast<uint32_t>(SEGMENT_ALIGNMENT) };
+  auto text_size{ static_cast<uint32_t>(m_text.size() * 4) };
+  auto data_offset{ (text_offset + text_size + SEGMENT_ALIGNMENT - 1) / SEGMENT_ALIGNMENT
+                    * SEGMENT_ALIGNMENT };
+  auto data_size{ static_cast<uint32_t>(m_bytes.size()) };
+  auto names_offset{ data_offset + data_size };
+  auto sections_offset{ (names_offset + static_cast<uint32_t>(names.size()) + 3) / 4 * 4 };
+
+  // ELF header: 32-bit, little-endian, executable, MIPS32 with the o32 ABI.
+  for (auto c : { '\x7f', 'E', 'L', 'F', '\x01', '\x01', '\x01' })
+    out.push_back(c);
+  pad(out, start, 16);
+  put16(out, 2);
+  put16(out, 8);
+  put32(out, 1);
+  put32(out, text_address);
+  put32(out, ELF_HEADER_SIZE);
+  put32(out, sections_offset);
+  put32(out, 0x50001000);
+  put16(out, ELF_HEADER_SIZE);
+  put16(out, PROGRAM_HEADER_SIZE);
+  put16(out, 3);
+  put16(out, SECTION_HEADER_SIZE);
+  put16(out, 5);
+  put16(out, 4);
+
+  auto program_header{ [&out](uint32_t offset, uint32_t address, uint32_t file_size, uint32_t memory_size,
+                              uint32_t flags) {
+    put32(out, 1);
+    put32(out, offset);
+    put32(out, address);
+    put32(out, address);
+    put32(out, file_size);
+    put32(out, memory_size);
+    put32(out, flags);
+    put32(out, SEGMENT_ALIGNMENT);
+  } };
+
+  // The small data area takes no space in the file, the loader fills it with zeros.
+  program_header(text_offset, text_address, text_size, text_size, 0x5);
+  program_header(data_offset, small_data_address, 0, m_small_data_size, 0x6);
+  program_header(data_offset, data_address, data_size, data_size, 0x6);
+
+  pad(out, start, SEGMENT_ALIGNMENT);
+  for (auto word : m_text)
+    put32(out, word);
+
+  pad(out, start, SEGMENT_ALIGNMENT);
+  out.append(m_bytes.data(), m_bytes.data() + m_bytes.size());
+  out.append(names.data(), names.data() + names.size());
+  pad(out, start, 4);
+
+  auto section_header{ [&out](uint32_t name, uint32_t type, uint32_t flags, uint32_t address, uint32_t offset,
+                              uint32_t size, uint32_t alignment) {
+    put32(out, name);
+    put32(out, type);
+    put32(out, flags);
+    put32(out, address);
+    put32(out, offset);
+    put32(out, size);
+    put32(out, 0);
+    put32(out, 0);
+    put32(out, alignment);
+    put32(out, 0);
+  } };
+
+  section_header(0, 0, 0, 0, 0, 0, 0);
+  section_header(text_name, 1, 0x6, text_address, text_offset, text_size, 4);
+  section_header(small_data_name, 8, 0x3, small_data_address, data_offset, m_small_data_size, 4);
+  section_header(data_name, 1, 0x3, data_address, data_offset, data_size, 1);
+  section_header(names_name, 3, 0, 0, names_offset, static_cast<uint32_t>(names.size()), 1);
+}
+
+}
@@ -1,3 +1,6 @@
+#include <cstdint>
+#include <limits>
+
 #include "ast.hpp"
 
 namespace cat
@@ -20,12 +23,25 @@ Program::add_stmt(Stmt* stmt) noexcept
   stmts_.push_back(stmt);
 }
 
+void
+Program::take_stmts(Program& other) noexcept
+{
+  stmts_.insert(stmts_.end(), other.stmts_.begin(), other.stmts_.end());
+  other.stmts_.clear();
+}
+
 std::vector<Stmt*>
 Program::stmts() const noexcept
 {
   return stmts_;
 }
 
+std::vector<Stmt*>&
+Program::stmts() noexcept
+{
+  return stmts_;
+}
+
 // LetStmt
 LetStmt::~LetStmt()
 {
@@ -39,12 +55,24 @@ LetStmt::identifier() const noexcept
   return *identifier_;
 }
 
+Identifier&
+LetStmt::identifier() noexcept
+{
+  return *identifier_;
+}
+
 Expr&
 LetStmt::value() const noexcept
 {
   return *value_;
 }
 
+void
+LetStmt::set_value(Expr* value) noexcept
+{
+  value_ = value;
+}
+
 void
 LetStmt::Accept(StmtVisitor& visitor)
 {
@@ -160,5 +188,52 @@ ComparisonExpr::Accept(ExprVisitor& visitor)
   return visitor.VisitComparisonExpr(*this);
 }
 
+namespace
+{
+
+bool
+is_constant(const Expr* expr) noexcept
+{
+  return expr->token().type() == TokenType::NUMBER || expr->token().type() == TokenType::CHAR;
+}
+
+/// Return true if the addition or subtraction `expr` is of two constants and does not overflow.
+bool
+fits(BinaryExpr* expr) noexcept
+{
+  if (!is_constant(expr->lhs()) || !is_constant(expr->rhs()))
+    return false;
+
+  int64_t lhs{ static_cast<Number*>(expr->lhs())->value() };
+  int64_t rhs{ static_cast<Number*>(expr->rhs())->value() };
+  auto result{ expr->token().type() == TokenType::PLUS ? lhs + rhs : lhs - rhs };
+
+  return result >= std::numeric_limits<int>::min() && result <= std::numeric_limits<int>::max();
+}
+
+}
+
+bool
+is_pure(Expr* expr) noexcept
+{
+  switch (expr->token().type())
+    {
+    case TokenType::WALRUS:
+      return false;
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+      return fits(static_cast<BinaryExpr*>(expr));
+    case TokenType::STAR:
+    case TokenType::LT:
+    case TokenType::LTE:
+    case TokenType::EQ:
+    case TokenType::GT:
+    case TokenType::GTE:
+      return is_pure(static_cast<BinaryExpr*>(expr)->lhs()) && is_pure(static_cast<BinaryExpr*>(expr)->rhs());
+    default:
+      return true;
+    }
+}
+
 } // namespace ast
 }
@@ -8,9 +8,14 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "ConstantFolder.hpp"
+#include "DeadCodeEliminator.hpp"
+#include "IRBuilder.hpp"
 #include "Lexer.hpp"
 #include "MIPSTranspiler.hpp"
 #include "Parser.hpp"
+#include "Passes.hpp"
+#include "Resolver.hpp"
 #include "cat.hpp"
 
 #define CAT_TMP_NAME "cat-out.mips"
@@ -116,11 +121,11 @@ execute(const std::string& program)
   return output;
 }
 
-bool
-transpile(const std::string& source, std::string& result, const std::string& file)
+/// Transpile `source` into `out`, appending any errors to `diagnostics`.
+static void
+compile(const std::string& source, fmt::memory_buffer& out, std::vector<Diagnostic>& diagnostics,
+        const Options& options)
 {
-  std::vector<cat::Diagnostic> diagnostics{};
-
   auto tokens{ Lexer{ source, diagnostics }.Lex() };
 
 #ifdef DEBUG
@@ -129,27 +134,154 @@ transpile(const std::string& source, std::string& result, const std::string& fil
     std::cout << token << "\n";
 #endif
 
-  auto program{ Parser(tokens, diagnostics).Parse() };
+  auto program{ Parser(tokens, diagnostics).ParseParallel(options.parse_jobs) };
 
 #ifdef DEBUG
   std::cout << "parser finished\n";
 #endif
 
-  result = MIPSTranspiler(std::move(program), diagnostics).Transpile();
+  Resolver{ diagnostics }.Resolve(*program);
+
+#ifdef DEBUG
+  std::cout << "resolver finished\n";
+#endif
+
+  // Code generation relies on every identifier being resolved.
+  if (diagnostics.size() > 0)
+    return;
+
+  auto statistics{ options.statistics };
+
+  if (options.fold_constants)
+    {
+      ConstantFolder folder{};
+      folder.Fold(*program);
+
+      if (statistics)
+        statistics->folded_expressions = folder.folded();
+    }
+
+  if (options.eliminate_dead_code)
+    {
+      DeadCodeEliminator eliminator{};
+      eliminator.Eliminate(*program);
+
+      // Removing declarations shifts the slots of the variables declared after them.
+      if (eliminator.removed_statements() > 0)
+        Resolver{ diagnostics }.Resolve(*program);
+
+      if (statistics)
+        {
+          statistics->removed_statements = eliminator.removed_statements();
+          statistics->pruned_branches = eliminator.pruned_branches();
+        }
+    }
+
+  auto function{ IRBuilder{}.Build(*program) };
+
+#ifdef DEBUG
+  std::cout << "lowering finished\n";
+#endif
+
+  if (options.optimize)
+    {
+      PassManager passes{};
+      passes.add<CFGSimplification>();
+      passes.add<SparseConditionalConstantPropagation>();
+      passes.add<ConstantPropagation>();
+      passes.add<CopyPropagation>();
+      passes.add<CommonSubexpressionElimination>();
+      passes.add<IfConversion>(options.remarks);
+      passes.add<LoopInvariantCodeMotion>(options.remarks);
+      passes.add<LoopUnrolling>(options.unroll_factor, options.remarks);
+      passes.add<PrintCoalescing>();
+      passes.add<DeadInstructionElimination>();
+      passes.Run(*function);
+
+      if (statistics)
+        for (const auto& [pass, changes] : passes.changes())
+          statistics->pass_changes.emplace_back(pass, changes);
+    }
+
+  if (options.emit == Emit::IR)
+    {
+      auto ir{ function->to_s() };
+      out.append(ir.data(), ir.data() + ir.size());
+      return;
+    }
+
+  MIPSTranspiler transpiler{ std::move(function), diagnostics, Peephole{ options.peephole },
+                             options.buffer_output };
+  if (options.emit == Emit::OBJECT)
+    transpiler.Assemble(out);
+  else
+    transpiler.Transpile(out);
 
 #ifdef DEBUG
   std::cout << "transpiler finished\n";
 #endif
 
+  if (statistics)
+    {
+      statistics->instructions = transpiler.instruction_count();
+      statistics->spilled_values = transpiler.spilled_count();
+
+      for (auto i = 0; i < Peephole::rule_count; i++)
+        {
+          auto rule{ static_cast<Peephole::Rule>(i) };
+          statistics->peephole_hits.emplace_back(Peephole::name(rule), transpiler.peephole().hits(rule));
+        }
+    }
+}
+
+bool
+transpile(const std::string& source, fmt::memory_buffer& result, const std::string& file,
+          const Options& options)
+{
+  std::vector<cat::Diagnostic> diagnostics{};
+
+  compile(source, result, diagnostics, options);
+
   if (diagnostics.size() == 0)
-    return true;
+    {
+      if (options.statistics && options.eliminate_dead_code)
+        {
+          // Measure what dead code elimination saved by compiling again without it.
+          Statistics without_dce_statistics{};
+          Options without_dce{ options };
+          without_dce.eliminate_dead_code = false;
+          without_dce.statistics = &without_dce_statistics;
+          without_dce.remarks = nullptr;
+
+          fmt::memory_buffer discarded{};
+          std::vector<Diagnostic> ignored{};
+          compile(source, discarded, ignored, without_dce);
+
+          options.statistics->dead_code_instructions
+              = without_dce_statistics.instructions - options.statistics->instructions;
+        }
+
+      return true;
+    }
 
   result.clear();
 
   for (const auto& diagnostic : diagnostics)
-    result += diagnostic.format(file, source);
+    {
+      auto message{ diagnostic.format(file, source) };
+      result.append(message.data(), message.data() + message.size());
+    }
 
   return false;
 }
 
+bool
+transpile(const std::string& source, std::string& result, const std::string& file, const Options& options)
+{
+  fmt::memory_buffer buffer{};
+  auto ok{ transpile(source, buffer, file, options) };
+  result.assign(buffer.data(), buffer.size());
+  return ok;
+}
+
 }
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+bool
+remove_unreachable_blocks(ir::Function& function)
+{
+  std::vector<bool> reachable(function.block_count, false);
+  for (auto block : function.reverse_postorder())
+    reachable[block->id] = true;
+
+  auto& blocks{ function.blocks };
+
+  for (const auto& block : blocks)
+    if (!reachable[block->id])
+      for (auto successor : block->successors)
+        if (reachable[successor->id])
+          successor->remove_predecessor(block.get());
+
+  auto end{ std::remove_if(blocks.begin(), blocks.end(),
+                           [&reachable](const auto& block) { return !reachable[block->id]; }) };
+  auto changed{ end != blocks.end() };
+  blocks.erase(end, blocks.end());
+
+  return changed;
+}
+
+/// Merge every block that is the only successor of its only predecessor into that predecessor.
+bool
+merge_blocks(ir::Function& function)
+{
+  std::unordered_map<ir::Instruction*, ir::Instruction*> replacements{};
+  std::vector<bool> merged(function.block_count, false);
+
+  for (const auto& block : function.blocks)
+    {
+      if (merged[block->id])
+        continue;
+
+      // Keep absorbing the successor, so that chains of blocks become one.
+      for (;;)
+        {
+          auto terminator{ block->terminator() };
+          if (terminator == nullptr || terminator->op != ir::Opcode::JUMP)
+            break;
+
+          auto successor{ block->successors.front() };
+          if (successor == block.get() || successor == function.entry()
+              || successor->predecessors.size() != 1)
+            break;
+
+          block->instructions.pop_back();
+
+          for (auto& instruction : successor->instructions)
+            {
+              // A phi with a single predecessor selects its only operand.
+              if (instruction->op == ir::Opcode::PHI)
+                replacements[instruction.get()] = instruction->operands.front();
+
+              instruction->block = block.get();
+              block->instructions.push_back(std::move(instruction));
+            }
+
+          successor->instructions.clear();
+          block->successors = std::move(successor->successors);
+          successor->successors.clear();
+
+          for (auto next : block->successors)
+            std::replace(next->predecessors.begin(), next->predecessors.end(), successor, block.get());
+
+          merged[successor->id] = true;
+        }
+    }
+
+  auto& blocks{ function.blocks };
+  auto end{ std::remove_if(blocks.begin(), blocks.end(),
+                           [&merged](const auto& block) { return merged[block->id]; }) };
+  auto changed{ end != blocks.end() };
+  blocks.erase(end, blocks.end());
+
+  function.replace(replacements);
+  return changed;
+}
+
+}
+
+bool
+CFGSimplification::Run(ir::Function& function)
+{
+  auto changed{ remove_unreachable_blocks(function) };
+  changed |= merge_blocks(function);
+  return changed;
+}
+
+}
@@ -0,0 +1,173 @@
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+/// What an instruction computes, independently of where it is.
+struct Expression
+{
+  ir::Opcode op;
+  int imm;
+  const ir::Instruction* lhs;
+  const ir::Instruction* rhs;
+
+  bool
+  operator==(const Expression& other) const noexcept
+  {
+    return op == other.op && imm == other.imm && lhs == other.lhs && rhs == other.rhs;
+  }
+};
+
+struct ExpressionHash
+{
+  std::size_t
+  operator()(const Expression& expression) const noexcept
+  {
+    auto hash{ std::hash<int>{}(static_cast<int>(expression.op)) };
+    hash = hash * 31 + std::hash<int>{}(expression.imm);
+    hash = hash * 31 + std::hash<const void*>{}(expression.lhs);
+    hash = hash * 31 + std::hash<const void*>{}(expression.rhs);
+    return hash;
+  }
+};
+
+bool
+is_pure(ir::Opcode op) noexcept
+{
+  switch (op)
+    {
+    case ir::Opcode::CONST:
+    case ir::Opcode::STRING:
+    case ir::Opcode::ADD:
+    case ir::Opcode::SUB:
+    case ir::Opcode::MUL:
+    case ir::Opcode::LT:
+    case ir::Opcode::LTE:
+    case ir::Opcode::EQ:
+    case ir::Opcode::GT:
+    case ir::Opcode::GTE:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/// Return the expression computed by `instruction`, with its operands in a canonical order.
+Expression
+expression(const ir::Instruction& instruction) noexcept
+{
+  Expression expression{ instruction.op, instruction.imm, nullptr, nullptr };
+
+  if (instruction.operands.size() == 2)
+    {
+      expression.lhs = instruction.operands[0];
+      expression.rhs = instruction.operands[1];
+    }
+
+  switch (expression.op)
+    {
+    case ir::Opcode::GT:
+      // x > y = y < x
+      expression.op = ir::Opcode::LT;
+      std::swap(expression.lhs, expression.rhs);
+      break;
+    case ir::Opcode::GTE:
+      // x >= y = y <= x
+      expression.op = ir::Opcode::LTE;
+      std::swap(expression.lhs, expression.rhs);
+      break;
+    case ir::Opcode::ADD:
+    case ir::Opcode::MUL:
+    case ir::Opcode::EQ:
+      if (expression.lhs->id > expression.rhs->id)
+        std::swap(expression.lhs, expression.rhs);
+      break;
+    default:
+      break;
+    }
+
+  return expression;
+}
+
+}
+
+bool
+CommonSubexpressionElimination::Run(ir::Function& function)
+{
+  function.compute_dominators();
+
+  std::unordered_map<ir::BasicBlock*, std::vector<ir::BasicBlock*> > children{};
+  for (auto block : function.reverse_postorder())
+    if (block != function.entry())
+      children[block->idom].push_back(block);
+
+  std::unordered_map<Expression, ir::Instruction*, ExpressionHash> available{};
+  std::unordered_map<ir::Instruction*, ir::Instruction*> replacements{};
+
+  // Walk the dominator tree, so that the expressions available in a block
+  // are the ones computed in the blocks that dominate it. Every entry on the
+  // stack is a block and whether it is being left, along with the
+  // expressions it made available.
+  struct Visit
+  {
+    ir::BasicBlock* block;
+    bool leaving;
+    std::vector<Expression> added;
+  };
+
+  std::vector<Visit> stack{ { function.entry(), false, {} } };
+
+  while (!stack.empty())
+    {
+      if (stack.back().leaving)
+        {
+          for (const auto& expression : stack.back().added)
+            available.erase(expression);
+          stack.pop_back();
+          continue;
+        }
+
+      stack.back().leaving = true;
+      auto block{ stack.back().block };
+      std::vector<Expression> added{};
+
+      for (const auto& instruction : block->instructions)
+        {
+          if (!is_pure(instruction->op))
+            continue;
+
+          // Operands replaced earlier in this walk are keyed by their replacement.
+          for (auto& operand : instruction->operands)
+            if (auto replacement{ replacements.find(operand) }; replacement != replacements.end())
+              operand = replacement->second;
+
+          auto key{ expression(*instruction) };
+
+          if (auto it{ available.find(key) }; it != available.end())
+            replacements[instruction.get()] = it->second;
+          else
+            {
+              available.emplace(key, instruction.get());
+              added.push_back(key);
+            }
+        }
+
+      stack.back().added = std::move(added);
+
+      for (auto child : children[block])
+        stack.push_back({ child, false, {} });
+    }
+
+  function.replace(replacements);
+  return !replacements.empty();
+}
+
+}
@@ -0,0 +1,366 @@
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "ConstantFolder.hpp"
+#include "ast.hpp"
+
+#define AS_EXPR(o) std::any_cast<ast::Expr*>(o)
+#define AS_NUMBER(o) static_cast<ast::Number*>(o)
+#define AS_BINARY(o) static_cast<ast::BinaryExpr*>(o)
+
+#define IS_CONSTANT(o) ((o)->token().type() == TokenType::NUMBER || (o)->token().type() == TokenType::CHAR)
+#define IS_STRING(o) ((o)->token().type() == TokenType::STRING)
+
+namespace cat
+{
+
+namespace
+{
+
+std::optional<int>
+constant(ast::Expr* expr) noexcept
+{
+  if (IS_CONSTANT(expr))
+    return AS_NUMBER(expr)->value();
+  return std::nullopt;
+}
+
+ast::Number*
+number(const ast::Expr& expr, int value)
+{
+  return new ast::Number{ Token{ TokenType::NUMBER, "", expr.token().span() }, value };
+}
+
+/// Return true if both expressions read the same variable.
+bool
+same_variable(ast::Expr* lhs, ast::Expr* rhs) noexcept
+{
+  return lhs->token().type() == TokenType::IDENTIFIER && rhs->token().type() == TokenType::IDENTIFIER
+         && static_cast<ast::Identifier*>(lhs)->slot() != -1
+         && static_cast<ast::Identifier*>(lhs)->slot() == static_cast<ast::Identifier*>(rhs)->slot();
+}
+
+/// Return the comparison that is equivalent to `token` when its operands are swapped.
+Token
+mirror(Token token) noexcept
+{
+  switch (token.type())
+    {
+    case TokenType::LT:
+      return { TokenType::GT, ">", token.span() };
+    case TokenType::LTE:
+      return { TokenType::GTE, ">=", token.span() };
+    case TokenType::GT:
+      return { TokenType::LT, "<", token.span() };
+    case TokenType::GTE:
+      return { TokenType::LTE, "<=", token.span() };
+    default:
+      return token;
+    }
+}
+
+bool
+compare(TokenType type, int lhs, int rhs) noexcept
+{
+  switch (type)
+    {
+    case TokenType::LT:
+      return lhs < rhs;
+    case TokenType::LTE:
+      return lhs <= rhs;
+    case TokenType::EQ:
+      return lhs == rhs;
+    case TokenType::GT:
+      return lhs > rhs;
+    case TokenType::GTE:
+      return lhs >= rhs;
+    default:
+      assert(false && "Unhandled comparison operator");
+    }
+
+  return false;
+}
+
+int
+wrapping_mult(int lhs, int rhs) noexcept
+{
+  return static_cast<int>(static_cast<std::uint32_t>(lhs) * static_cast<std::uint32_t>(rhs));
+}
+
+}
+
+void
+ConstantFolder::Fold(ast::Program& program)
+{
+  program.Accept(*this);
+}
+
+ast::Expr*
+ConstantFolder::fold(ast::Expr* expr)
+{
+  return AS_EXPR(expr->Accept(*this));
+}
+
+void
+ConstantFolder::fold_operands(ast::BinaryExpr& expr)
+{
+  expr.set_lhs(fold(expr.lhs()));
+  expr.set_rhs(fold(expr.rhs()));
+
+  // Characters are numbers too, but code generation only uses immediates for
+  // NUMBER tokens.
+  if (expr.lhs()->token().type() == TokenType::CHAR)
+    {
+      auto lhs{ expr.lhs() };
+      expr.set_lhs(number(*lhs, AS_NUMBER(lhs)->value()));
+      delete lhs;
+    }
+
+  if (expr.rhs()->token().type() == TokenType::CHAR)
+    {
+      auto rhs{ expr.rhs() };
+      expr.set_rhs(number(*rhs, AS_NUMBER(rhs)->value()));
+      delete rhs;
+    }
+}
+
+void
+ConstantFolder::canonicalize(ast::BinaryExpr& expr) noexcept
+{
+  if (IS_CONSTANT(expr.lhs()) && !IS_CONSTANT(expr.rhs()))
+    {
+      auto lhs{ expr.lhs() };
+      expr.set_lhs(expr.rhs());
+      expr.set_rhs(lhs);
+    }
+}
+
+ast::Expr*
+ConstantFolder::replace(ast::BinaryExpr& expr, ast::Expr* replacement)
+{
+  if (replacement == expr.lhs())
+    expr.set_lhs(nullptr);
+  if (replacement == expr.rhs())
+    expr.set_rhs(nullptr);
+
+  delete &expr;
+  m_folded++;
+
+  return replacement;
+}
+
+/*
+ * Statements
+ */
+
+void
+ConstantFolder::VisitProgram(ast::Program& program)
+{
+  for (ast::Stmt* stmt : program.stmts())
+    stmt->Accept(*this);
+}
+
+void
+ConstantFolder::VisitLetStmt(ast::LetStmt& stmt)
+{
+  stmt.set_value(fold(&stmt.value()));
+}
+
+void
+ConstantFolder::VisitIfStmt(ast::IfStmt& stmt)
+{
+  stmt.set_condition(fold(stmt.condition()));
+
+  for (auto branch_stmt : stmt.if_branch())
+    branch_stmt->Accept(*this);
+
+  for (auto branch_stmt : stmt.else_branch())
+    branch_stmt->Accept(*this);
+}
+
+void
+ConstantFolder::VisitForStmt(ast::ForStmt& stmt)
+{
+  for (const auto& body_stmt : stmt.stmts())
+    body_stmt->Accept(*this);
+}
+
+void
+ConstantFolder::VisitPrintStmt(ast::PrintStmt& stmt)
+{
+  for (auto& expr : stmt.exprs())
+    {
+      // The syscall used to print an expression depends on its token, so a
+      // folded expression must keep printing as a number.
+      auto type{ expr->token().type() };
+      expr = fold(expr);
+
+      if (type != TokenType::CHAR && expr->token().type() == TokenType::CHAR)
+        {
+          auto folded{ expr };
+          expr = number(*folded, AS_NUMBER(folded)->value());
+          delete folded;
+        }
+    }
+}
+
+void
+ConstantFolder::VisitExprStmt(ast::ExprStmt& stmt)
+{
+  stmt.expr().reset(fold(stmt.expr().release()));
+}
+
+/*
+ * Expressions
+ */
+
+std::any
+ConstantFolder::VisitNumber(ast::Number& expr)
+{
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+ConstantFolder::VisitString(ast::String& expr)
+{
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+ConstantFolder::VisitIdentifier(ast::Identifier& identifier)
+{
+  return static_cast<ast::Expr*>(&identifier);
+}
+
+std::any
+ConstantFolder::VisitAddExpr(ast::AddExpr& expr)
+{
+  fold_operands(expr);
+  canonicalize(expr);
+
+  auto lhs{ constant(expr.lhs()) };
+  auto rhs{ constant(expr.rhs()) };
+
+  if (int sum; lhs && rhs && !__builtin_add_overflow(*lhs, *rhs, &sum))
+    return replace(expr, number(expr, sum));
+
+  // x + 0 = x
+  if (rhs == 0 && !IS_STRING(expr.lhs()))
+    return replace(expr, expr.lhs());
+
+  // (x + c1) + c2 = x + (c1 + c2), provided that both constants have the same
+  // sign, so that the folded expression overflows exactly when the original does.
+  if (rhs && expr.lhs()->token().type() == TokenType::PLUS)
+    {
+      auto inner{ AS_BINARY(expr.lhs()) };
+      auto c1{ constant(inner->rhs()) };
+
+      if (int sum; c1 && (*c1 < 0) == (*rhs < 0) && !__builtin_add_overflow(*c1, *rhs, &sum))
+        {
+          auto c1_expr{ inner->rhs() };
+          inner->set_rhs(number(*c1_expr, sum));
+          delete c1_expr;
+          return replace(expr, inner);
+        }
+    }
+
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+ConstantFolder::VisitSubExpr(ast::SubExpr& expr)
+{
+  fold_operands(expr);
+
+  auto lhs{ constant(expr.lhs()) };
+  auto rhs{ constant(expr.rhs()) };
+
+  if (int difference; lhs && rhs && !__builtin_sub_overflow(*lhs, *rhs, &difference))
+    return replace(expr, number(expr, difference));
+
+  // x - 0 = x
+  if (rhs == 0 && !IS_STRING(expr.lhs()))
+    return replace(expr, expr.lhs());
+
+  // x - x = 0
+  if (same_variable(expr.lhs(), expr.rhs()))
+    return replace(expr, number(expr, 0));
+
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+ConstantFolder::VisitMultExpr(ast::MultExpr& expr)
+{
+  fold_operands(expr);
+  canonicalize(expr);
+
+  auto lhs{ constant(expr.lhs()) };
+  auto rhs{ constant(expr.rhs()) };
+
+  if (lhs && rhs)
+    return replace(expr, number(expr, wrapping_mult(*lhs, *rhs)));
+
+  // x * 1 = x
+  if (rhs == 1 && !IS_STRING(expr.lhs()))
+    return replace(expr, expr.lhs());
+
+  // x * 0 = 0, unless evaluating x has side effects
+  if (rhs == 0 && ast::is_pure(expr.lhs()))
+    return replace(expr, number(expr, 0));
+
+  // (x * c1) * c2 = x * (c1 * c2)
+  if (rhs && expr.lhs()->token().type() == TokenType::STAR)
+    {
+      auto inner{ AS_BINARY(expr.lhs()) };
+
+      if (auto c1{ constant(inner->rhs()) }; c1)
+        {
+          auto c1_expr{ inner->rhs() };
+          inner->set_rhs(number(*c1_expr, wrapping_mult(*c1, *rhs)));
+          delete c1_expr;
+          return replace(expr, inner);
+        }
+    }
+
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+ConstantFolder::VisitAssignExpr(ast::AssignExpr& expr)
+{
+  expr.set_rhs(fold(expr.rhs()));
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+ConstantFolder::VisitComparisonExpr(ast::ComparisonExpr& expr)
+{
+  fold_operands(expr);
+
+  auto type{ expr.token().type() };
+  auto lhs{ constant(expr.lhs()) };
+  auto rhs{ constant(expr.rhs()) };
+
+  if (lhs && rhs)
+    return replace(expr, number(expr, compare(type, *lhs, *rhs)));
+
+  // x < x is false, while x <= x and x = x are true
+  if (same_variable(expr.lhs(), expr.rhs()))
+    return replace(expr,
+                   number(expr, type == TokenType::LTE || type == TokenType::EQ || type == TokenType::GTE));
+
+  // c < x = x > c
+  if (lhs)
+    {
+      auto mirrored{ new ast::ComparisonExpr{ mirror(expr.token()), expr.rhs(), expr.lhs() } };
+      expr.set_lhs(nullptr);
+      expr.set_rhs(nullptr);
+      return replace(expr, mirrored);
+    }
+
+  return static_cast<ast::Expr*>(&expr);
+}
+
+}
@@ -0,0 +1,153 @@
+#include <optional>
+#include <unordered_map>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+std::optional<int>
+constant(const ir::Instruction* value) noexcept
+{
+  if (value->op == ir::Opcode::CONST)
+    return value->imm;
+  return std::nullopt;
+}
+
+void
+make_constant(ir::Instruction& instruction, int value) noexcept
+{
+  instruction.op = ir::Opcode::CONST;
+  instruction.operands.clear();
+  instruction.imm = value;
+}
+
+/// Return the operand `instruction` is equivalent to, if an identity applies.
+ir::Instruction*
+identity(ir::Instruction& instruction) noexcept
+{
+  auto lhs{ instruction.operands[0] };
+  auto rhs{ instruction.operands[1] };
+
+  switch (instruction.op)
+    {
+    case ir::Opcode::ADD:
+      // x + 0 = 0 + x = x
+      if (constant(rhs) == 0)
+        return lhs;
+      if (constant(lhs) == 0)
+        return rhs;
+      return nullptr;
+    case ir::Opcode::SUB:
+      // x - 0 = x
+      return constant(rhs) == 0 ? lhs : nullptr;
+    case ir::Opcode::MUL:
+      // x * 1 = 1 * x = x
+      if (constant(rhs) == 1)
+        return lhs;
+      if (constant(lhs) == 1)
+        return rhs;
+      return nullptr;
+    default:
+      return nullptr;
+    }
+}
+
+}
+
+bool
+ConstantPropagation::Run(ir::Function& function)
+{
+  auto changed{ false };
+  std::unordered_map<ir::Instruction*, ir::Instruction*> replacements{};
+
+  for (auto block : function.reverse_postorder())
+    for (const auto& instruction : block->instructions)
+      {
+        if (instruction->op == ir::Opcode::BRANCH)
+          {
+            auto condition{ constant(instruction->operands[0]) };
+            if (!condition)
+              continue;
+
+            // Keep the edge that is taken and drop the other one.
+            auto taken{ block->successors[*condition ? 0 : 1] };
+            auto dead{ block->successors[*condition ? 1 : 0] };
+
+            dead->remove_predecessor(block);
+            block->successors = { taken };
+            instruction->op = ir::Opcode::JUMP;
+            instruction->operands.clear();
+            changed = true;
+            continue;
+          }
+
+        if (instruction->op == ir::Opcode::SELECT)
+          {
+            auto& operands{ instruction->operands };
+            if (auto condition{ constant(operands[0]) }; condition)
+              replacements[instruction.get()] = operands[*condition ? 1 : 2];
+            else if (operands[1] == operands[2])
+              replacements[instruction.get()] = operands[1];
+            continue;
+          }
+
+        if (instruction->operands.size() != 2 || instruction->op == ir::Opcode::PHI)
+          continue;
+
+        auto lhs{ constant(instruction->operands[0]) };
+        auto rhs{ constant(instruction->operands[1]) };
+
+        if (lhs && rhs)
+          {
+            if (auto result{ ir::evaluate(instruction->op, *lhs, *rhs) }; result)
+              {
+                make_constant(*instruction, *result);
+                changed = true;
+              }
+            continue;
+          }
+
+        if (auto value{ identity(*instruction) }; value)
+          {
+            replacements[instruction.get()] = value;
+            continue;
+          }
+
+        // x * 0 = 0
+        if (instruction->op == ir::Opcode::MUL && (lhs == 0 || rhs == 0))
+          {
+            make_constant(*instruction, 0);
+            changed = true;
+            continue;
+          }
+
+        // x - x = 0, x < x is false, while x <= x and x = x are true
+        if (instruction->operands[0] == instruction->operands[1])
+          switch (instruction->op)
+            {
+            case ir::Opcode::SUB:
+            case ir::Opcode::LT:
+            case ir::Opcode::GT:
+              make_constant(*instruction, 0);
+              changed = true;
+              break;
+            case ir::Opcode::LTE:
+            case ir::Opcode::EQ:
+            case ir::Opcode::GTE:
+              make_constant(*instruction, 1);
+              changed = true;
+              break;
+            default:
+              break;
+            }
+      }
+
+  function.replace(replacements);
+  return changed || !replacements.empty();
+}
+
+}
@@ -0,0 +1,46 @@
+#include <unordered_map>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+/// Return the only value other than itself that `phi` selects, or nullptr if there are several.
+ir::Instruction*
+unique_operand(ir::Instruction& phi) noexcept
+{
+  ir::Instruction* value{ nullptr };
+
+  for (auto operand : phi.operands)
+    {
+      if (operand == &phi || operand == value)
+        continue;
+      if (value != nullptr)
+        return nullptr;
+      value = operand;
+    }
+
+  return value;
+}
+
+}
+
+bool
+CopyPropagation::Run(ir::Function& function)
+{
+  std::unordered_map<ir::Instruction*, ir::Instruction*> replacements{};
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      if (instruction->op == ir::Opcode::PHI)
+        if (auto value{ unique_operand(*instruction) }; value)
+          replacements[instruction.get()] = value;
+
+  function.replace(replacements);
+  return !replacements.empty();
+}
+
+}
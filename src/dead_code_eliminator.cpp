@@ -0,0 +1,436 @@
+#include "DeadCodeEliminator.hpp"
+#include "ast.hpp"
+
+#define AS_EXPR(o) std::any_cast<ast::Expr*>(o)
+#define AS_NUMBER(o) static_cast<ast::Number*>(o)
+
+#define IS_CONSTANT(o) ((o)->token().type() == TokenType::NUMBER || (o)->token().type() == TokenType::CHAR)
+
+namespace cat
+{
+
+namespace
+{
+
+/**
+ * Count the reads of every variable declared by a let statement and
+ * remember which declaration every assignment writes to.
+ *
+ * A slot is only reused once the scope of its previous variable has ended,
+ * so the last declaration seen for a slot is the one its uses refer to.
+ */
+class ReadCounter final : public ExprVisitor, public StmtVisitor
+{
+public:
+  ReadCounter(std::unordered_map<const ast::LetStmt*, int>& reads,
+              std::unordered_map<const ast::AssignExpr*, const ast::LetStmt*>& assignments)
+      : m_reads{ reads }, m_assignments{ assignments }
+  {
+  }
+
+  void
+  VisitProgram(ast::Program& program) override
+  {
+    for (auto stmt : program.stmts())
+      stmt->Accept(*this);
+  }
+
+  void
+  VisitLetStmt(ast::LetStmt& stmt) override
+  {
+    stmt.value().Accept(*this);
+    declare(stmt.identifier().slot(), &stmt);
+    m_reads.try_emplace(&stmt, 0);
+  }
+
+  void
+  VisitIfStmt(ast::IfStmt& stmt) override
+  {
+    stmt.condition()->Accept(*this);
+    for (auto branch_stmt : stmt.if_branch())
+      branch_stmt->Accept(*this);
+    for (auto branch_stmt : stmt.else_branch())
+      branch_stmt->Accept(*this);
+  }
+
+  void
+  VisitForStmt(ast::ForStmt& stmt) override
+  {
+    stmt.from()->Accept(*this);
+    stmt.to()->Accept(*this);
+    declare(static_cast<ast::Identifier*>(stmt.loop_var().get())->slot(), nullptr);
+    for (const auto& body_stmt : stmt.stmts())
+      body_stmt->Accept(*this);
+  }
+
+  void
+  VisitPrintStmt(ast::PrintStmt& stmt) override
+  {
+    for (auto expr : stmt.exprs())
+      {
+        // A printed assignment is never removed, so neither is the declaration it writes to.
+        if (expr->token().type() == TokenType::WALRUS)
+          {
+            auto identifier{ static_cast<ast::Identifier*>(static_cast<ast::AssignExpr*>(expr)->lhs()) };
+            if (auto declaration{ declaration_of(identifier->slot()) }; declaration)
+              m_reads[declaration]++;
+          }
+        expr->Accept(*this);
+      }
+  }
+
+  void
+  VisitExprStmt(ast::ExprStmt& stmt) override
+  {
+    stmt.expr()->Accept(*this);
+  }
+
+  std::any
+  VisitNumber([[maybe_unused]] ast::Number& expr) override
+  {
+    return {};
+  }
+
+  std::any
+  VisitString([[maybe_unused]] ast::String& expr) override
+  {
+    return {};
+  }
+
+  std::any
+  VisitIdentifier(ast::Identifier& identifier) override
+  {
+    if (auto declaration{ declaration_of(identifier.slot()) }; declaration)
+      m_reads[declaration]++;
+    return {};
+  }
+
+  std::any
+  VisitAddExpr(ast::AddExpr& expr) override
+  {
+    expr.lhs()->Accept(*this);
+    expr.rhs()->Accept(*this);
+    return {};
+  }
+
+  std::any
+  VisitSubExpr(ast::SubExpr& expr) override
+  {
+    expr.lhs()->Accept(*this);
+    expr.rhs()->Accept(*this);
+    return {};
+  }
+
+  std::any
+  VisitMultExpr(ast::MultExpr& expr) override
+  {
+    expr.lhs()->Accept(*this);
+    expr.rhs()->Accept(*this);
+    return {};
+  }
+
+  std::any
+  VisitAssignExpr(ast::AssignExpr& expr) override
+  {
+    // Writing a variable does not read it.
+    if (auto declaration{ declaration_of(static_cast<ast::Identifier*>(expr.lhs())->slot()) }; declaration)
+      m_assignments[&expr] = declaration;
+    expr.rhs()->Accept(*this);
+    return {};
+  }
+
+  std::any
+  VisitComparisonExpr(ast::ComparisonExpr& expr) override
+  {
+    expr.lhs()->Accept(*this);
+    expr.rhs()->Accept(*this);
+    return {};
+  }
+
+private:
+  void
+  declare(int slot, const ast::LetStmt* declaration)
+  {
+    if (static_cast<std::size_t>(slot) >= m_declarations.size())
+      m_declarations.resize(slot + 1);
+    m_declarations[slot] = declaration;
+  }
+
+  /// Return the declaration living in `slot`, or nullptr if it has been removed.
+  [[nodiscard]] const ast::LetStmt*
+  declaration_of(int slot) const noexcept
+  {
+    return static_cast<std::size_t>(slot) < m_declarations.size() ? m_declarations[slot] : nullptr;
+  }
+
+  std::unordered_map<const ast::LetStmt*, int>& m_reads;
+  std::unordered_map<const ast::AssignExpr*, const ast::LetStmt*>& m_assignments;
+  /// The declaration of the variable currently living in every slot.
+  std::vector<const ast::LetStmt*> m_declarations = {};
+};
+
+}
+
+void
+DeadCodeEliminator::Eliminate(ast::Program& program)
+{
+  do
+    {
+      m_reads.clear();
+      m_assignments.clear();
+
+      ReadCounter counter{ m_reads, m_assignments };
+      program.Accept(counter);
+
+      m_changed = false;
+      program.Accept(*this);
+    }
+  while (m_changed);
+}
+
+bool
+DeadCodeEliminator::is_read(const ast::LetStmt& stmt) const noexcept
+{
+  auto reads{ m_reads.find(&stmt) };
+  return reads == m_reads.end() || reads->second > 0;
+}
+
+bool
+DeadCodeEliminator::sweep(std::vector<ast::Stmt*>& stmts)
+{
+  auto removed{ false };
+  std::vector<ast::Stmt*> live{};
+
+  for (auto stmt : stmts)
+    {
+      stmt->Accept(*this);
+
+      if (m_replacement != stmt)
+        {
+          delete stmt;
+          m_removed_statements++;
+          removed = true;
+        }
+
+      if (m_replacement != nullptr)
+        live.push_back(m_replacement);
+    }
+
+  stmts = std::move(live);
+  m_changed |= removed;
+  return removed;
+}
+
+bool
+DeadCodeEliminator::sweep(std::vector<std::unique_ptr<ast::Stmt> >& stmts)
+{
+  auto removed{ false };
+  std::vector<std::unique_ptr<ast::Stmt> > live{};
+
+  for (auto& stmt : stmts)
+    {
+      stmt->Accept(*this);
+
+      if (m_replacement != stmt.get())
+        {
+          stmt.reset(m_replacement);
+          m_removed_statements++;
+          removed = true;
+        }
+
+      if (stmt != nullptr)
+        live.push_back(std::move(stmt));
+    }
+
+  stmts = std::move(live);
+  m_changed |= removed;
+  return removed;
+}
+
+ast::Expr*
+DeadCodeEliminator::rewrite(ast::Expr* expr)
+{
+  return AS_EXPR(expr->Accept(*this));
+}
+
+/*
+ * Statements
+ *
+ * Every statement visitor sets m_replacement to the statement that should
+ * take the place of the visited one.
+ */
+
+void
+DeadCodeEliminator::VisitProgram(ast::Program& program)
+{
+  sweep(program.stmts());
+}
+
+void
+DeadCodeEliminator::VisitLetStmt(ast::LetStmt& stmt)
+{
+  stmt.set_value(rewrite(&stmt.value()));
+
+  if (is_read(stmt))
+    {
+      m_replacement = &stmt;
+      return;
+    }
+
+  if (ast::is_pure(&stmt.value()))
+    {
+      m_replacement = nullptr;
+      return;
+    }
+
+  // The variable is never read, but its value must still be evaluated.
+  m_replacement = new ast::ExprStmt{ &stmt.value() };
+  stmt.set_value(nullptr);
+}
+
+void
+DeadCodeEliminator::VisitIfStmt(ast::IfStmt& stmt)
+{
+  stmt.set_condition(rewrite(stmt.condition()));
+
+  if (IS_CONSTANT(stmt.condition()))
+    {
+      auto& dead_branch{ AS_NUMBER(stmt.condition())->value() ? stmt.else_branch() : stmt.if_branch() };
+
+      if (!dead_branch.empty())
+        {
+          for (auto dead_stmt : dead_branch)
+            delete dead_stmt;
+          dead_branch.clear();
+          m_pruned_branches++;
+          m_changed = true;
+        }
+    }
+
+  sweep(stmt.if_branch());
+  sweep(stmt.else_branch());
+
+  auto is_empty{ stmt.if_branch().empty() && stmt.else_branch().empty() };
+  m_replacement = is_empty && ast::is_pure(stmt.condition()) ? nullptr : &stmt;
+}
+
+void
+DeadCodeEliminator::VisitForStmt(ast::ForStmt& stmt)
+{
+  // A range whose bounds are known to be empty never runs the body.
+  auto from{ stmt.from().get() };
+  auto to{ stmt.to().get() };
+  if (IS_CONSTANT(from) && IS_CONSTANT(to) && AS_NUMBER(from)->value() >= AS_NUMBER(to)->value())
+    {
+      m_replacement = nullptr;
+      return;
+    }
+
+  sweep(stmt.stmts());
+
+  // The bounds are numbers or variables, so a loop doing nothing can go.
+  m_replacement = stmt.stmts().empty() ? nullptr : &stmt;
+}
+
+void
+DeadCodeEliminator::VisitPrintStmt(ast::PrintStmt& stmt)
+{
+  for (auto& expr : stmt.exprs())
+    {
+      m_print_argument = expr;
+      expr = rewrite(expr);
+    }
+
+  m_print_argument = nullptr;
+  m_replacement = &stmt;
+}
+
+void
+DeadCodeEliminator::VisitExprStmt(ast::ExprStmt& stmt)
+{
+  stmt.expr().reset(rewrite(stmt.expr().release()));
+  m_replacement = ast::is_pure(stmt.expr().get()) ? nullptr : &stmt;
+}
+
+/*
+ * Expressions
+ *
+ * Every expression visitor returns the expression that should take the
+ * place of the visited one.
+ */
+
+std::any
+DeadCodeEliminator::VisitNumber(ast::Number& expr)
+{
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+DeadCodeEliminator::VisitString(ast::String& expr)
+{
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+DeadCodeEliminator::VisitIdentifier(ast::Identifier& identifier)
+{
+  return static_cast<ast::Expr*>(&identifier);
+}
+
+std::any
+DeadCodeEliminator::VisitAddExpr(ast::AddExpr& expr)
+{
+  expr.set_lhs(rewrite(expr.lhs()));
+  expr.set_rhs(rewrite(expr.rhs()));
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+DeadCodeEliminator::VisitSubExpr(ast::SubExpr& expr)
+{
+  expr.set_lhs(rewrite(expr.lhs()));
+  expr.set_rhs(rewrite(expr.rhs()));
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+DeadCodeEliminator::VisitMultExpr(ast::MultExpr& expr)
+{
+  expr.set_lhs(rewrite(expr.lhs()));
+  expr.set_rhs(rewrite(expr.rhs()));
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+DeadCodeEliminator::VisitAssignExpr(ast::AssignExpr& expr)
+{
+  expr.set_rhs(rewrite(expr.rhs()));
+
+  // The syscall used to print an expression depends on its token, so a printed assignment is kept to print
+  // its value as a number, even when the value is a character or a string.
+  if (&expr == m_print_argument)
+    return static_cast<ast::Expr*>(&expr);
+
+  // Assigning a variable that is never read only needs to evaluate the value.
+  if (auto declaration{ m_assignments.find(&expr) };
+      declaration != m_assignments.end() && !is_read(*declaration->second))
+    {
+      auto value{ expr.rhs() };
+      expr.set_rhs(nullptr);
+      delete &expr;
+      m_changed = true;
+      return value;
+    }
+
+  return static_cast<ast::Expr*>(&expr);
+}
+
+std::any
+DeadCodeEliminator::VisitComparisonExpr(ast::ComparisonExpr& expr)
+{
+  expr.set_lhs(rewrite(expr.lhs()));
+  expr.set_rhs(rewrite(expr.rhs()));
+  return static_cast<ast::Expr*>(&expr);
+}
+
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+bool
+DeadInstructionElimination::Run(ir::Function& function)
+{
+  std::vector<bool> live(function.value_count, false);
+  std::vector<ir::Instruction*> worklist{};
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      if (instruction->has_side_effects() || instruction->may_trap())
+        {
+          live[instruction->id] = true;
+          worklist.push_back(instruction.get());
+        }
+
+  while (!worklist.empty())
+    {
+      auto instruction{ worklist.back() };
+      worklist.pop_back();
+
+      for (auto operand : instruction->operands)
+        if (!live[operand->id])
+          {
+            live[operand->id] = true;
+            worklist.push_back(operand);
+          }
+    }
+
+  auto changed{ false };
+
+  for (const auto& block : function.blocks)
+    {
+      auto& instructions{ block->instructions };
+      auto end{ std::remove_if(instructions.begin(), instructions.end(),
+                               [&live](const auto& instruction) { return !live[instruction->id]; }) };
+
+      changed |= end != instructions.end();
+      instructions.erase(end, instructions.end());
+    }
+
+  // Keep the string literals that are still used, in the order they are first used. Passes add literals
+  // without looking for an equal one, so equal literals are merged here.
+  std::vector<int> renumbered(function.strings.size(), -1);
+  std::unordered_map<std::string, int> numbers{};
+  std::vector<std::string> strings{};
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      if (instruction->op == ir::Opcode::STRING)
+        {
+          auto& number{ renumbered[instruction->imm] };
+          if (number == -1)
+            {
+              auto& literal{ function.strings[instruction->imm] };
+              auto [it, inserted]{ numbers.try_emplace(literal, static_cast<int>(strings.size())) };
+              if (inserted)
+                strings.push_back(std::move(literal));
+              number = it->second;
+            }
+          instruction->imm = number;
+        }
+
+  changed |= strings.size() != function.strings.size();
+  function.strings = std::move(strings);
+
+  return changed;
+}
+
+}
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Passes.hpp"
+
+/// The most instructions, selects included, that converting an if statement may run whichever way it goes.
+#define MAX_CONVERTED_SIZE 4
+
+namespace cat
+{
+
+namespace
+{
+
+/// Return true if `instruction` may run whether or not the branch it is in is taken.
+bool
+is_speculatable(const ir::Instruction& instruction) noexcept
+{
+  switch (instruction.op)
+    {
+    case ir::Opcode::CONST:
+    case ir::Opcode::STRING:
+    case ir::Opcode::MUL:
+    case ir::Opcode::LT:
+    case ir::Opcode::LTE:
+    case ir::Opcode::EQ:
+    case ir::Opcode::GT:
+    case ir::Opcode::GTE:
+    case ir::Opcode::SELECT:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/**
+ * Return the block `successor` of `branch` leads to if it is a branch of
+ * an if statement that can be converted, or `successor` itself if the edge
+ * goes straight to where the branches meet. Return nullptr otherwise.
+ */
+ir::BasicBlock*
+join_of(const ir::BasicBlock* branch, ir::BasicBlock* successor) noexcept
+{
+  if (successor->predecessors.size() != 1)
+    return successor;
+
+  if (successor->successors.size() != 1 || successor->terminator()->op != ir::Opcode::JUMP)
+    return nullptr;
+
+  for (auto it{ successor->instructions.begin() }; it != successor->instructions.end() - 1; ++it)
+    if (!is_speculatable(**it))
+      return nullptr;
+
+  return successor->predecessors.front() == branch ? successor->successors.front() : nullptr;
+}
+
+/// Return the number of instructions in `block` that are not materialized where they are used.
+int
+instruction_count(const ir::BasicBlock* block) noexcept
+{
+  return std::count_if(block->instructions.begin(), block->instructions.end(), [](const auto& instruction) {
+    return instruction->op != ir::Opcode::CONST && instruction->op != ir::Opcode::STRING
+           && !instruction->is_terminator();
+  });
+}
+
+/// Return true if `value` is used by anything but `user`.
+bool
+has_other_uses(const ir::Function& function, const ir::Instruction* value, const ir::Instruction* user)
+{
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      if (instruction.get() != user
+          && std::find(instruction->operands.begin(), instruction->operands.end(), value)
+                 != instruction->operands.end())
+        return true;
+
+  return false;
+}
+
+}
+
+bool
+IfConversion::Run(ir::Function& function)
+{
+  std::vector<bool> removed(function.block_count, false);
+  std::unordered_map<ir::Instruction*, ir::Instruction*> replacements{};
+  auto changed{ false };
+
+  for (const auto& block : function.blocks)
+    {
+      auto branch{ block->terminator() };
+      if (removed[block->id] || branch == nullptr || branch->op != ir::Opcode::BRANCH)
+        continue;
+
+      auto taken{ block->successors[0] };
+      auto not_taken{ block->successors[1] };
+      auto join{ join_of(block.get(), taken) };
+
+      if (taken == not_taken || join == nullptr || join != join_of(block.get(), not_taken)
+          || join == block.get() || join == function.entry() || join->predecessors.size() != 2)
+        continue;
+
+      // The edges into the join, from the branches or straight from the block.
+      auto from_taken{ taken == join ? block.get() : taken };
+      auto from_not_taken{ not_taken == join ? block.get() : not_taken };
+
+      std::vector<ir::Instruction*> phis{};
+      auto selects{ 0 };
+      for (const auto& instruction : join->instructions)
+        if (instruction->op == ir::Opcode::PHI)
+          {
+            phis.push_back(instruction.get());
+            if (instruction->operands[join->predecessor_index(from_taken)]
+                != instruction->operands[join->predecessor_index(from_not_taken)])
+              selects++;
+          }
+
+      auto converted_size{ selects + (taken != join ? instruction_count(taken) : 0)
+                           + (not_taken != join ? instruction_count(not_taken) : 0) };
+      if (converted_size > MAX_CONVERTED_SIZE)
+        continue;
+
+      // x >= y is x < y negated and x <= y is y < x negated, so the selects swap their operands rather
+      // than negating the condition.
+      auto condition{ branch->operands[0] };
+      auto negated{ false };
+      if ((condition->op == ir::Opcode::GTE || condition->op == ir::Opcode::LTE) && selects > 0
+          && !has_other_uses(function, condition, branch))
+        {
+          if (condition->op == ir::Opcode::LTE)
+            std::swap(condition->operands[0], condition->operands[1]);
+          condition->op = ir::Opcode::LT;
+          negated = true;
+        }
+
+      auto& instructions{ block->instructions };
+      instructions.pop_back();
+
+      for (auto arm : { taken, not_taken })
+        {
+          if (arm == join)
+            continue;
+
+          arm->instructions.pop_back();
+          for (auto& instruction : arm->instructions)
+            {
+              instruction->block = block.get();
+              instructions.push_back(std::move(instruction));
+            }
+
+          arm->instructions.clear();
+          arm->predecessors.clear();
+          arm->successors.clear();
+          removed[arm->id] = true;
+        }
+
+      for (auto phi : phis)
+        {
+          auto if_true{ phi->operands[join->predecessor_index(from_taken)] };
+          auto if_false{ phi->operands[join->predecessor_index(from_not_taken)] };
+          if (negated)
+            std::swap(if_true, if_false);
+
+          replacements[phi] = if_true == if_false
+                                  ? if_true
+                                  : function.append(block.get(), ir::Opcode::SELECT,
+                                                    { condition, if_true, if_false });
+        }
+
+      function.append(block.get(), ir::Opcode::JUMP);
+      block->successors = { join };
+      join->predecessors = { block.get() };
+
+      // The phis now have the block as their only predecessor, until they are replaced.
+      for (auto phi : phis)
+        phi->operands.resize(1);
+
+      changed = true;
+
+      if (m_remarks != nullptr)
+        m_remarks->push_back(fmt::format("branch in L{}: converted into {} select{}", block->id, selects,
+                                         selects == 1 ? "" : "s"));
+    }
+
+  auto& blocks{ function.blocks };
+  blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                              [&removed](const auto& block) { return removed[block->id]; }),
+               blocks.end());
+
+  function.replace(replacements);
+  return changed;
+}
+
+}
@@ -0,0 +1,246 @@
+#include <iterator>
+
+#include <fmt/format.h>
+
+#include "Instruction.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+/// The names of the registers by number. Any operand indexes it, the missing one too.
+const char* const register_names[256]{
+  "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3", "$t0", "$t1", "$t2",
+  "$t3",   "$t4", "$t5", "$t6", "$t7", "$s0", "$s1", "$s2", "$s3", "$s4", "$s5",
+  "$s6",   "$s7", "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra",
+};
+
+const char*
+mnemonic(Instruction::Opcode op) noexcept
+{
+  switch (op)
+    {
+    case Instruction::Opcode::LABEL:
+      return "";
+    case Instruction::Opcode::LI:
+      return "li";
+    case Instruction::Opcode::LA:
+      return "la";
+    case Instruction::Opcode::MOVE:
+      return "move";
+    case Instruction::Opcode::ADD:
+      return "add";
+    case Instruction::Opcode::ADDU:
+      return "addu";
+    case Instruction::Opcode::SUB:
+      return "sub";
+    case Instruction::Opcode::SUBU:
+      return "subu";
+    case Instruction::Opcode::MULT:
+      return "mult";
+    case Instruction::Opcode::MFLO:
+      return "mflo";
+    case Instruction::Opcode::DIVU:
+      return "divu";
+    case Instruction::Opcode::MFHI:
+      return "mfhi";
+    case Instruction::Opcode::ADDI:
+      return "addi";
+    case Instruction::Opcode::LW:
+      return "lw";
+    case Instruction::Opcode::SW:
+      return "sw";
+    case Instruction::Opcode::LBU:
+      return "lbu";
+    case Instruction::Opcode::SB:
+      return "sb";
+    case Instruction::Opcode::SLT:
+      return "slt";
+    case Instruction::Opcode::SLTU:
+      return "sltu";
+    case Instruction::Opcode::SLTI:
+      return "slti";
+    case Instruction::Opcode::SLTIU:
+      return "sltiu";
+    case Instruction::Opcode::MOVN:
+      return "movn";
+    case Instruction::Opcode::MOVZ:
+      return "movz";
+    case Instruction::Opcode::XOR:
+      return "xor";
+    case Instruction::Opcode::XORI:
+      return "xori";
+    case Instruction::Opcode::ORI:
+      return "ori";
+    case Instruction::Opcode::LUI:
+      return "lui";
+    case Instruction::Opcode::SLL:
+      return "sll";
+    case Instruction::Opcode::BEQ:
+      return "beq";
+    case Instruction::Opcode::BNE:
+      return "bne";
+    case Instruction::Opcode::BLTZ:
+      return "bltz";
+    case Instruction::Opcode::BGEZ:
+      return "bgez";
+    case Instruction::Opcode::BLEZ:
+      return "blez";
+    case Instruction::Opcode::BGTZ:
+      return "bgtz";
+    case Instruction::Opcode::J:
+      return "j";
+    case Instruction::Opcode::JAL:
+      return "jal";
+    case Instruction::Opcode::JR:
+      return "jr";
+    case Instruction::Opcode::SYSCALL:
+      return "syscall";
+    }
+
+  return "";
+}
+
+}
+
+void
+write(fmt::memory_buffer& out, const std::vector<Instruction>& instructions)
+{
+  using Opcode = Instruction::Opcode;
+
+  auto it{ std::back_inserter(out) };
+
+  for (const auto& instruction : instructions)
+    {
+      auto name{ mnemonic(instruction.op) };
+      auto rd{ register_names[instruction.rd] };
+      auto rs{ register_names[instruction.rs] };
+      auto rt{ register_names[instruction.rt] };
+      auto imm{ instruction.imm };
+
+      switch (instruction.op)
+        {
+        case Opcode::LABEL:
+          fmt::format_to(it, "L{}:\n", imm);
+          break;
+        case Opcode::LI:
+        case Opcode::LUI:
+          fmt::format_to(it, "{:4} {}, {}\n", name, rd, imm);
+          break;
+        case Opcode::LA:
+          fmt::format_to(it, "{:4} {}, L{}\n", name, rd, imm);
+          break;
+        case Opcode::MOVE:
+          fmt::format_to(it, "{:4} {}, {}\n", name, rd, rs);
+          break;
+        case Opcode::MULT:
+        case Opcode::DIVU:
+          fmt::format_to(it, "{:4} {}, {}\n", name, rs, rt);
+          break;
+        case Opcode::MFLO:
+        case Opcode::MFHI:
+          fmt::format_to(it, "{:4} {}\n", name, rd);
+          break;
+        case Opcode::ADDI:
+        case Opcode::SLTI:
+        case Opcode::SLTIU:
+        case Opcode::XORI:
+        case Opcode::ORI:
+        case Opcode::SLL:
+          fmt::format_to(it, "{:4} {}, {}, {}\n", name, rd, rs, imm);
+          break;
+        case Opcode::LW:
+        case Opcode::LBU:
+          fmt::format_to(it, "{:4} {}, {}({})\n", name, rd, imm, rs);
+          break;
+        case Opcode::SW:
+        case Opcode::SB:
+          fmt::format_to(it, "{:4} {}, {}({})\n", name, rt, imm, rs);
+          break;
+        case Opcode::BEQ:
+        case Opcode::BNE:
+          fmt::format_to(it, "{:4} {}, {}, L{}\n", name, rs, rt, imm);
+          break;
+        case Opcode::BLTZ:
+        case Opcode::BGEZ:
+        case Opcode::BLEZ:
+        case Opcode::BGTZ:
+          fmt::format_to(it, "{:4} {}, L{}\n", name, rs, imm);
+          break;
+        case Opcode::J:
+        case Opcode::JAL:
+          fmt::format_to(it, "{:4} L{}\n", name, imm);
+          break;
+        case Opcode::JR:
+          fmt::format_to(it, "{:4} {}\n", name, rs);
+          break;
+        case Opcode::SYSCALL:
+          fmt::format_to(it, "{}\n", name);
+          break;
+        default:
+          fmt::format_to(it, "{:4} {}, {}, {}\n", name, rd, rs, rt);
+          break;
+        }
+    }
+}
+
+void
+write(fmt::memory_buffer& out, const std::vector<Datum>& data)
+{
+  auto it{ std::back_inserter(out) };
+
+  for (const auto& datum : data)
+    if (datum.literal.empty())
+      fmt::format_to(it, "L{}:     .space {}\n", datum.label, datum.size);
+    else
+      fmt::format_to(it, "L{}:     {} {}\n", datum.label, datum.terminated ? ".asciiz" : ".ascii ",
+                     datum.literal);
+}
+
+bool
+Instruction::reads(register_t reg) const noexcept
+{
+  // System calls take their service in $v0 and their argument in $a0.
+  if (op == Opcode::SYSCALL)
+    return reg == register_t{ register_t::name::V0 } || reg == register_t{ register_t::name::A0 };
+
+  // Conditional moves keep the destination when they do not move.
+  if (op == Opcode::MOVN || op == Opcode::MOVZ)
+    return reg == rs || reg == rt || reg == rd;
+
+  return reg == rs || reg == rt;
+}
+
+bool
+Instruction::writes(register_t reg) const noexcept
+{
+  if (op == Opcode::SYSCALL)
+    return reg == register_t{ register_t::name::V0 };
+
+  return reg == rd;
+}
+
+bool
+Instruction::is_control() const noexcept
+{
+  switch (op)
+    {
+    case Opcode::LABEL:
+    case Opcode::BEQ:
+    case Opcode::BNE:
+    case Opcode::BLTZ:
+    case Opcode::BGEZ:
+    case Opcode::BLEZ:
+    case Opcode::BGTZ:
+    case Opcode::J:
+    case Opcode::JAL:
+    case Opcode::JR:
+      return true;
+    default:
+      return false;
+    }
+}
+
+}
@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include <fmt/core.h>
+
+#include "ir.hpp"
+
+namespace cat
+{
+
+namespace ir
+{
+
+const char*
+opcode_as_str(Opcode op) noexcept
+{
+  switch (op)
+    {
+    case Opcode::CONST:
+      return "const";
+    case Opcode::STRING:
+      return "string";
+    case Opcode::ADD:
+      return "add";
+    case Opcode::SUB:
+      return "sub";
+    case Opcode::MUL:
+      return "mul";
+    case Opcode::LT:
+      return "lt";
+    case Opcode::LTE:
+      return "lte";
+    case Opcode::EQ:
+      return "eq";
+    case Opcode::GT:
+      return "gt";
+    case Opcode::GTE:
+      return "gte";
+    case Opcode::SELECT:
+      return "select";
+    case Opcode::PHI:
+      return "phi";
+    case Opcode::PRINT:
+      return "print";
+    case Opcode::JUMP:
+      return "jump";
+    case Opcode::BRANCH:
+      return "branch";
+    case Opcode::RETURN:
+      return "return";
+    }
+
+  assert(false && "Unhandled opcode");
+  return "";
+}
+
+bool
+is_comparison(Opcode op) noexcept
+{
+  return op == Opcode::LT || op == Opcode::LTE || op == Opcode::EQ || op == Opcode::GT || op == Opcode::GTE;
+}
+
+std::optional<int>
+evaluate(Opcode op, int lhs, int rhs) noexcept
+{
+  int result{};
+
+  switch (op)
+    {
+    case Opcode::ADD:
+      // Additions and subtractions trap on overflow at run time.
+      if (__builtin_add_overflow(lhs, rhs, &result))
+        return std::nullopt;
+      return result;
+    case Opcode::SUB:
+      if (__builtin_sub_overflow(lhs, rhs, &result))
+        return std::nullopt;
+      return result;
+    case Opcode::MUL:
+      return static_cast<int>(static_cast<std::uint32_t>(lhs) * static_cast<std::uint32_t>(rhs));
+    case Opcode::LT:
+      return lhs < rhs;
+    case Opcode::LTE:
+      return lhs <= rhs;
+    case Opcode::EQ:
+      return lhs == rhs;
+    case Opcode::GT:
+      return lhs > rhs;
+    case Opcode::GTE:
+      return lhs >= rhs;
+    default:
+      return std::nullopt;
+    }
+}
+
+/*
+ * Instruction
+ */
+
+bool
+Instruction::has_result() const noexcept
+{
+  return op != Opcode::PRINT && !is_terminator();
+}
+
+bool
+Instruction::is_terminator() const noexcept
+{
+  return op == Opcode::JUMP || op == Opcode::BRANCH || op == Opcode::RETURN;
+}
+
+bool
+Instruction::has_side_effects() const noexcept
+{
+  return !has_result();
+}
+
+bool
+Instruction::may_trap() const noexcept
+{
+  if (op != Opcode::ADD && op != Opcode::SUB)
+    return false;
+
+  return operands[0]->op != Opcode::CONST || operands[1]->op != Opcode::CONST
+         || !evaluate(op, operands[0]->imm, operands[1]->imm).has_value();
+}
+
+std::string
+Instruction::to_s() const
+{
+  std::string s{ has_result() ? fmt::format("%{} = {}", id, opcode_as_str(op)) : opcode_as_str(op) };
+  auto separator{ " " };
+
+  if (op == Opcode::PHI)
+    for (std::size_t i = 0; i < operands.size(); i++, separator = ", ")
+      s += fmt::format("{}[%{}, L{}]", separator, operands[i]->id, block->predecessors[i]->id);
+  else
+    for (auto operand : operands)
+      {
+        s += fmt::format("{}%{}", separator, operand->id);
+        separator = ", ";
+      }
+
+  if (op == Opcode::CONST || op == Opcode::STRING || op == Opcode::PRINT)
+    s += fmt::format("{}{}", separator, imm);
+
+  if (op == Opcode::JUMP || op == Opcode::BRANCH)
+    for (auto successor : block->successors)
+      {
+        s += fmt::format("{}L{}", separator, successor->id);
+        separator = ", ";
+      }
+
+  return s;
+}
+
+/*
+ * BasicBlock
+ */
+
+Instruction*
+BasicBlock::terminator() const noexcept
+{
+  if (instructions.empty() || !instructions.back()->is_terminator())
+    return nullptr;
+  return instructions.back().get();
+}
+
+std::size_t
+BasicBlock::predecessor_index(const BasicBlock* block) const noexcept
+{
+  auto it{ std::find(predecessors.begin(), predecessors.end(), block) };
+  assert(it != predecessors.end() && "block is not a predecessor");
+  return it - predecessors.begin();
+}
+
+void
+BasicBlock::remove_predecessor(const BasicBlock* block)
+{
+  auto index{ predecessor_index(block) };
+  predecessors.erase(predecessors.begin() + index);
+
+  for (const auto& instruction : instructions)
+    {
+      if (instruction->op != Opcode::PHI)
+        break;
+      instruction->operands.erase(instruction->operands.begin() + index);
+    }
+}
+
+std::string
+BasicBlock::to_s() const
+{
+  std::string s{ fmt::format("L{}:\n", id) };
+
+  for (const auto& instruction : instructions)
+    s += fmt::format("  {}\n", instruction->to_s());
+
+  return s;
+}
+
+/*
+ * Function
+ */
+
+BasicBlock*
+Function::create_block()
+{
+  return blocks.emplace_back(std::make_unique<BasicBlock>(block_count++)).get();
+}
+
+Instruction*
+Function::append(BasicBlock* block, Opcode op, std::vector<Instruction*> operands, int imm)
+{
+  assert(block->terminator() == nullptr && "appending to a terminated block");
+
+  auto& instruction{ block->instructions.emplace_back(
+      std::make_unique<Instruction>(op, value_count++, block)) };
+  instruction->operands = std::move(operands);
+  instruction->imm = imm;
+  return instruction.get();
+}
+
+Instruction*
+Function::insert_phi(BasicBlock* block)
+{
+  auto position{ std::find_if(block->instructions.begin(), block->instructions.end(),
+                              [](const auto& instruction) { return instruction->op != Opcode::PHI; }) };
+
+  auto phi{ std::make_unique<Instruction>(Opcode::PHI, value_count++, block) };
+  return block->instructions.insert(position, std::move(phi))->get();
+}
+
+void
+Function::add_edge(BasicBlock* from, BasicBlock* to)
+{
+  from->successors.push_back(to);
+  to->predecessors.push_back(from);
+}
+
+void
+Function::split_critical_edges()
+{
+  // New blocks are laid out last, so only the blocks that exist now are visited.
+  for (std::size_t i = 0, size = blocks.size(); i < size; i++)
+    {
+      auto block{ blocks[i].get() };
+      if (block->successors.size() < 2)
+        continue;
+
+      for (auto& successor : block->successors)
+        {
+          if (successor->instructions.empty() || successor->instructions.front()->op != Opcode::PHI)
+            continue;
+
+          auto split{ create_block() };
+          append(split, Opcode::JUMP);
+          split->predecessors.push_back(block);
+          split->successors.push_back(successor);
+          successor->predecessors[successor->predecessor_index(block)] = split;
+          successor = split;
+        }
+    }
+}
+
+void
+Function::replace(const std::unordered_map<Instruction*, Instruction*>& replacements)
+{
+  if (replacements.empty())
+    return;
+
+  // Follow chains of replacements, so that replacing a by b and b by c
+  // replaces a by c.
+  auto resolve{ [&replacements](Instruction* value) {
+    for (auto it{ replacements.find(value) }; it != replacements.end(); it = replacements.find(value))
+      value = it->second;
+    return value;
+  } };
+
+  for (const auto& block : blocks)
+    {
+      auto& instructions{ block->instructions };
+
+      for (const auto& instruction : instructions)
+        for (auto& operand : instruction->operands)
+          operand = resolve(operand);
+
+      instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+                                        [&replacements](const auto& instruction) {
+                                          return replacements.count(instruction.get()) > 0;
+                                        }),
+                         instructions.end());
+    }
+}
+
+std::vector<BasicBlock*>
+Function::reverse_postorder() const
+{
+  std::vector<BasicBlock*> postorder{};
+  std::vector<bool> visited(block_count, false);
+
+  // Depth first search with an explicit stack, so that long chains of blocks
+  // cannot overflow the native one.
+  std::vector<std::pair<BasicBlock*, std::size_t> > stack{ { entry(), 0 } };
+  visited[entry()->id] = true;
+
+  while (!stack.empty())
+    {
+      auto& [block, next] = stack.back();
+
+      if (next < block->successors.size())
+        {
+          auto successor{ block->successors[next++] };
+          if (!visited[successor->id])
+            {
+              visited[successor->id] = true;
+              stack.emplace_back(successor, 0);
+            }
+          continue;
+        }
+
+      postorder.push_back(block);
+      stack.pop_back();
+    }
+
+  std::reverse(postorder.begin(), postorder.end());
+  return postorder;
+}
+
+void
+Function::compute_dominators()
+{
+  // "A Simple, Fast Dominance Algorithm", by Cooper, Harvey and Kennedy.
+  auto order{ reverse_postorder() };
+  std::vector<int> position(block_count, -1);
+
+  for (const auto& block : blocks)
+    block->idom = nullptr;
+
+  for (std::size_t i = 0; i < order.size(); i++)
+    position[order[i]->id] = i;
+
+  auto intersect{ [&position](BasicBlock* a, BasicBlock* b) {
+    while (a != b)
+      {
+        while (position[a->id] > position[b->id])
+          a = a->idom;
+        while (position[b->id] > position[a->id])
+          b = b->idom;
+      }
+    return a;
+  } };
+
+  entry()->idom = entry();
+
+  for (auto changed{ true }; changed;)
+    {
+      changed = false;
+
+      for (auto block : order)
+        {
+          if (block == entry())
+            continue;
+
+          BasicBlock* idom{ nullptr };
+          for (auto predecessor : block->predecessors)
+            if (predecessor->idom != nullptr)
+              idom = idom == nullptr ? predecessor : intersect(predecessor, idom);
+
+          if (block->idom != idom)
+            {
+              block->idom = idom;
+              changed = true;
+            }
+        }
+    }
+}
+
+bool
+Function::dominates(const BasicBlock* a, const BasicBlock* b) const noexcept
+{
+  for (;; b = b->idom)
+    {
+      if (a == b)
+        return true;
+      if (b == nullptr || b == b->idom)
+        return false;
+    }
+}
+
+std::vector<Loop>
+Function::find_loops() const
+{
+  auto order{ reverse_postorder() };
+  std::vector<Loop> loops{};
+
+  for (auto header : order)
+    {
+      std::vector<BasicBlock*> latches{};
+      for (auto predecessor : header->predecessors)
+        if (dominates(header, predecessor))
+          latches.push_back(predecessor);
+
+      // The front end gives every loop a single back edge.
+      if (latches.size() != 1)
+        continue;
+
+      // The loop is the header and every block that reaches the latch without going through it.
+      std::vector<bool> inside(block_count, false);
+      std::vector<BasicBlock*> worklist{ latches.front() };
+      inside[header->id] = true;
+
+      while (!worklist.empty())
+        {
+          auto block{ worklist.back() };
+          worklist.pop_back();
+
+          if (inside[block->id])
+            continue;
+
+          inside[block->id] = true;
+          worklist.insert(worklist.end(), block->predecessors.begin(), block->predecessors.end());
+        }
+
+      Loop loop{ header, latches.front(), nullptr, {} };
+
+      for (auto block : order)
+        if (inside[block->id])
+          loop.blocks.push_back(block);
+
+      std::vector<BasicBlock*> entries{};
+      for (auto predecessor : header->predecessors)
+        if (!inside[predecessor->id])
+          entries.push_back(predecessor);
+
+      if (entries.size() == 1 && entries.front()->successors.size() == 1)
+        loop.preheader = entries.front();
+
+      loops.push_back(std::move(loop));
+    }
+
+  // An inner loop is a part of the loops around it.
+  std::stable_sort(loops.begin(), loops.end(),
+                   [](const Loop& a, const Loop& b) { return a.blocks.size() < b.blocks.size(); });
+
+  return loops;
+}
+
+std::string
+Function::to_s() const
+{
+  std::string s{};
+
+  for (std::size_t i = 0; i < strings.size(); i++)
+    s += fmt::format("string {} = {}\n", i, strings[i]);
+
+  for (const auto& block : blocks)
+    s += block->to_s();
+
+  return s;
+}
+
+}
+}
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cassert>
+
+#include "IRBuilder.hpp"
+#include "ast.hpp"
+
+#define AS_VALUE(o) std::any_cast<ir::Instruction*>(o)
+
+namespace cat
+{
+
+std::unique_ptr<ir::Function>
+IRBuilder::Build(ast::Program& program)
+{
+  m_function = std::make_unique<ir::Function>();
+  m_block = m_function->entry();
+  m_definitions.resize(1);
+  m_incomplete_phis.resize(1);
+  m_sealed = { true };
+
+  program.Accept(*this);
+  emit(ir::Opcode::RETURN);
+
+  return std::move(m_function);
+}
+
+ir::Instruction*
+IRBuilder::lower(ast::Expr* expr)
+{
+  return AS_VALUE(expr->Accept(*this));
+}
+
+std::pair<ir::Instruction*, ir::Instruction*>
+IRBuilder::lower_operands(ast::BinaryExpr& expr)
+{
+  if (m_labels.count(&expr) == 0)
+    label(&expr);
+
+  const auto& lhs{ m_labels[expr.lhs()] };
+  const auto& rhs{ m_labels[expr.rhs()] };
+
+  if (lhs.pure && rhs.pure && rhs.need > lhs.need)
+    {
+      auto value{ lower(expr.rhs()) };
+      return { lower(expr.lhs()), value };
+    }
+
+  auto value{ lower(expr.lhs()) };
+  return { value, lower(expr.rhs()) };
+}
+
+IRBuilder::Label
+IRBuilder::label(ast::Expr* expr)
+{
+  Label result{ 0, true };
+
+  switch (expr->token().type())
+    {
+    case TokenType::WALRUS:
+      result = { label(static_cast<ast::BinaryExpr*>(expr)->rhs()).need, false };
+      break;
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+    case TokenType::STAR:
+    case TokenType::LT:
+    case TokenType::LTE:
+    case TokenType::EQ:
+    case TokenType::GT:
+    case TokenType::GTE:
+      {
+        auto lhs{ label(static_cast<ast::BinaryExpr*>(expr)->lhs()) };
+        auto rhs{ label(static_cast<ast::BinaryExpr*>(expr)->rhs()) };
+
+        // Numbers and variables are leaves that need no new register.
+        result.need = lhs.need == rhs.need ? lhs.need + 1 : std::max(lhs.need, rhs.need);
+        result.pure = lhs.pure && rhs.pure;
+        break;
+      }
+    default:
+      break;
+    }
+
+  m_labels[expr] = result;
+  return result;
+}
+
+ir::Instruction*
+IRBuilder::emit(ir::Opcode op, std::vector<ir::Instruction*> operands, int imm)
+{
+  return m_function->append(m_block, op, std::move(operands), imm);
+}
+
+ir::BasicBlock*
+IRBuilder::create_block()
+{
+  auto block{ m_function->create_block() };
+
+  m_definitions.resize(m_function->block_count);
+  m_incomplete_phis.resize(m_function->block_count);
+  m_sealed.resize(m_function->block_count, false);
+
+  return block;
+}
+
+/*
+ * SSA construction
+ */
+
+void
+IRBuilder::write_variable(int slot, ir::BasicBlock* block, ir::Instruction* value)
+{
+  m_definitions[block->id][slot] = value;
+}
+
+ir::Instruction*
+IRBuilder::read_variable(int slot, ir::BasicBlock* block)
+{
+  auto& definitions{ m_definitions[block->id] };
+
+  if (auto definition{ definitions.find(slot) }; definition != definitions.end())
+    {
+      auto value{ definition->second };
+      if (value->op == ir::Opcode::PHI && m_sealed[value->block->id]
+          && value->operands.size() < value->block->predecessors.size())
+        m_cyclic_phis.insert(value);
+      return value;
+    }
+
+  return read_variable_recursive(slot, block);
+}
+
+ir::Instruction*
+IRBuilder::read_variable_recursive(int slot, ir::BasicBlock* block)
+{
+  ir::Instruction* value{};
+
+  if (!m_sealed[block->id])
+    {
+      // Not every predecessor is known yet, so the operands are added once
+      // the block is sealed.
+      value = m_function->insert_phi(block);
+      value->imm = slot;
+      m_incomplete_phis[block->id].emplace_back(slot, value);
+    }
+  else if (block->predecessors.size() == 1)
+    {
+      value = read_variable(slot, block->predecessors.front());
+    }
+  else
+    {
+      // Break cycles by defining the variable before reading it in the predecessors.
+      auto phi{ m_function->insert_phi(block) };
+      phi->imm = slot;
+      write_variable(slot, block, phi);
+      value = remove_trivial_phi(add_phi_operands(slot, phi));
+    }
+
+  write_variable(slot, block, value);
+  return value;
+}
+
+ir::Instruction*
+IRBuilder::add_phi_operands(int slot, ir::Instruction* phi)
+{
+  for (auto predecessor : phi->block->predecessors)
+    phi->operands.push_back(read_variable(slot, predecessor));
+  return phi;
+}
+
+ir::Instruction*
+IRBuilder::remove_trivial_phi(ir::Instruction* phi)
+{
+  auto same{ phi->operands.front() };
+  for (auto operand : phi->operands)
+    if (operand != same || operand == phi)
+      return phi;
+
+  // The phi was just created in a sealed block, so nothing uses it yet,
+  // unless a loop led back to it. Copy propagation removes it then.
+  if (m_cyclic_phis.count(phi) != 0)
+    return phi;
+
+  auto& instructions{ phi->block->instructions };
+  instructions.erase(std::find_if(instructions.begin(), instructions.end(),
+                                  [phi](const auto& instruction) { return instruction.get() == phi; }));
+  return same;
+}
+
+void
+IRBuilder::seal(ir::BasicBlock* block)
+{
+  // Completing the phis may read variables in this block, which must not
+  // create new incomplete phis. Trivial phis may already be used by then,
+  // so they are left to copy propagation.
+  m_sealed[block->id] = true;
+
+  for (auto [slot, phi] : m_incomplete_phis[block->id])
+    add_phi_operands(slot, phi);
+
+  m_incomplete_phis[block->id].clear();
+}
+
+/*
+ * Statements
+ */
+
+void
+IRBuilder::VisitProgram(ast::Program& program)
+{
+  for (ast::Stmt* stmt : program.stmts())
+    stmt->Accept(*this);
+}
+
+void
+IRBuilder::VisitLetStmt(ast::LetStmt& stmt)
+{
+  assert(stmt.identifier().slot() != -1 && "identifier was not resolved");
+  write_variable(stmt.identifier().slot(), m_block, lower(&stmt.value()));
+}
+
+void
+IRBuilder::VisitIfStmt(ast::IfStmt& stmt)
+{
+  auto condition{ lower(stmt.condition()) };
+
+  // Both branches get a block, even when they are empty, so that no edge
+  // goes from a block with several successors to one with several predecessors.
+  auto if_block{ create_block() };
+  auto else_block{ create_block() };
+  auto exit_block{ create_block() };
+
+  emit(ir::Opcode::BRANCH, { condition });
+  m_function->add_edge(m_block, if_block);
+  m_function->add_edge(m_block, else_block);
+  seal(if_block);
+  seal(else_block);
+
+  m_block = if_block;
+  for (auto branch_stmt : stmt.if_branch())
+    branch_stmt->Accept(*this);
+  emit(ir::Opcode::JUMP);
+  m_function->add_edge(m_block, exit_block);
+
+  m_block = else_block;
+  for (auto branch_stmt : stmt.else_branch())
+    branch_stmt->Accept(*this);
+  emit(ir::Opcode::JUMP);
+  m_function->add_edge(m_block, exit_block);
+
+  seal(exit_block);
+  m_block = exit_block;
+}
+
+void
+IRBuilder::VisitForStmt(ast::ForStmt& stmt)
+{
+  auto slot{ static_cast<ast::Identifier*>(stmt.loop_var().get())->slot() };
+  assert(slot != -1 && "identifier was not resolved");
+
+  auto from{ lower(stmt.from().get()) };
+  auto to{ lower(stmt.to().get()) };
+
+  // Constant bounds decide at compile time whether the body runs at all.
+  auto is_constant{ from->op == ir::Opcode::CONST && to->op == ir::Opcode::CONST };
+  if (is_constant && from->imm >= to->imm)
+    return;
+
+  write_variable(slot, m_block, from);
+
+  // Otherwise the loop is guarded by a test of the bounds, so that the
+  // test at the bottom of the body is the only branch run per iteration.
+  auto guard{ m_block };
+  if (!is_constant)
+    {
+      emit(ir::Opcode::BRANCH, { emit(ir::Opcode::LT, { from, to }) });
+
+      auto preheader{ create_block() };
+      m_function->add_edge(guard, preheader);
+      seal(preheader);
+      m_block = preheader;
+    }
+
+  auto body_block{ create_block() };
+  emit(ir::Opcode::JUMP);
+  m_function->add_edge(m_block, body_block);
+
+  m_block = body_block;
+  for (const auto& body_stmt : stmt.stmts())
+    body_stmt->Accept(*this);
+
+  auto next{ emit(ir::Opcode::ADD, { read_variable(slot, m_block), emit(ir::Opcode::CONST, {}, 1) }) };
+  write_variable(slot, m_block, next);
+  emit(ir::Opcode::BRANCH, { emit(ir::Opcode::LT, { next, to }) });
+
+  // The exit is created last so that it is laid out right after the body.
+  auto exit_block{ create_block() };
+  m_function->add_edge(m_block, body_block);
+  m_function->add_edge(m_block, exit_block);
+  if (!is_constant)
+    m_function->add_edge(guard, exit_block);
+
+  seal(body_block);
+  seal(exit_block);
+  m_block = exit_block;
+}
+
+void
+IRBuilder::VisitPrintStmt(ast::PrintStmt& stmt)
+{
+  for (auto expr : stmt.exprs())
+    {
+      int service = expr->token().type() == TokenType::CHAR     ? 11
+                    : expr->token().type() == TokenType::STRING ? 4
+                                                                : 1;
+      emit(ir::Opcode::PRINT, { lower(expr) }, service);
+    }
+}
+
+void
+IRBuilder::VisitExprStmt(ast::ExprStmt& stmt)
+{
+  lower(stmt.expr().get());
+}
+
+/*
+ * Expressions
+ */
+
+std::any
+IRBuilder::VisitNumber(ast::Number& expr)
+{
+  return emit(ir::Opcode::CONST, {}, expr.value());
+}
+
+std::any
+IRBuilder::VisitString(ast::String& expr)
+{
+  // Equal literals share one string of the data section.
+  auto [it, inserted]{ m_strings.try_emplace(expr.value(), static_cast<int>(m_function->strings.size())) };
+  if (inserted)
+    m_function->strings.push_back(expr.value());
+
+  return emit(ir::Opcode::STRING, {}, it->second);
+}
+
+std::any
+IRBuilder::VisitIdentifier(ast::Identifier& identifier)
+{
+  assert(identifier.slot() != -1 && "identifier was not resolved");
+  return read_variable(identifier.slot(), m_block);
+}
+
+std::any
+IRBuilder::VisitAddExpr(ast::AddExpr& expr)
+{
+  auto [lhs, rhs] = lower_operands(expr);
+  return emit(ir::Opcode::ADD, { lhs, rhs });
+}
+
+std::any
+IRBuilder::VisitSubExpr(ast::SubExpr& expr)
+{
+  auto [lhs, rhs] = lower_operands(expr);
+  return emit(ir::Opcode::SUB, { lhs, rhs });
+}
+
+std::any
+IRBuilder::VisitMultExpr(ast::MultExpr& expr)
+{
+  auto [lhs, rhs] = lower_operands(expr);
+  return emit(ir::Opcode::MUL, { lhs, rhs });
+}
+
+std::any
+IRBuilder::VisitAssignExpr(ast::AssignExpr& expr)
+{
+  auto identifier{ static_cast<ast::Identifier*>(expr.lhs()) };
+  assert(identifier->slot() != -1 && "identifier was not resolved");
+
+  auto value{ lower(expr.rhs()) };
+  write_variable(identifier->slot(), m_block, value);
+  return value;
+}
+
+std::any
+IRBuilder::VisitComparisonExpr(ast::ComparisonExpr& expr)
+{
+  auto [lhs, rhs] = lower_operands(expr);
+
+  switch (expr.token().type())
+    {
+    case TokenType::LT:
+      return emit(ir::Opcode::LT, { lhs, rhs });
+    case TokenType::LTE:
+      return emit(ir::Opcode::LTE, { lhs, rhs });
+    case TokenType::EQ:
+      return emit(ir::Opcode::EQ, { lhs, rhs });
+    case TokenType::GT:
+      return emit(ir::Opcode::GT, { lhs, rhs });
+    case TokenType::GTE:
+      return emit(ir::Opcode::GTE, { lhs, rhs });
+    default:
+      assert(false && "Unhandled comparison operator");
+      return {};
+    }
+}
+
+}
@@ -0,0 +1,55 @@
+#include "Liveness.hpp"
+
+namespace cat
+{
+
+Liveness::Liveness(const ir::Function& function)
+    : m_live_in(function.block_count), m_live_out(function.block_count)
+{
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      for (std::size_t i = 0; i < instruction->operands.size(); i++)
+        {
+          auto operand{ instruction->operands[i] };
+          if (!is_tracked(*operand))
+            continue;
+
+          if (instruction->op == ir::Opcode::PHI)
+            {
+              auto predecessor{ block->predecessors[i] };
+              m_live_out[predecessor->id].insert(operand);
+              propagate(operand, predecessor);
+            }
+          else
+            propagate(operand, block.get());
+        }
+}
+
+bool
+Liveness::is_tracked(const ir::Instruction& value) noexcept
+{
+  return value.has_result() && value.op != ir::Opcode::CONST && value.op != ir::Opcode::STRING;
+}
+
+void
+Liveness::propagate(const ir::Instruction* value, ir::BasicBlock* block)
+{
+  m_worklist.push_back(block);
+
+  while (!m_worklist.empty())
+    {
+      auto current{ m_worklist.back() };
+      m_worklist.pop_back();
+
+      if (current == value->block || !m_live_in[current->id].insert(value).second)
+        continue;
+
+      for (auto predecessor : current->predecessors)
+        {
+          m_live_out[predecessor->id].insert(value);
+          m_worklist.push_back(predecessor);
+        }
+    }
+}
+
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+/**
+ * Return true if `instruction` may run before the loop, given whether it
+ * runs on every iteration before the iteration has printed anything.
+ * Instructions that may trap must not trap sooner than they would have.
+ */
+bool
+is_movable(const ir::Instruction& instruction, bool before_side_effects) noexcept
+{
+  if (instruction.may_trap())
+    return before_side_effects;
+
+  switch (instruction.op)
+    {
+    case ir::Opcode::PHI:
+    case ir::Opcode::PRINT:
+    case ir::Opcode::JUMP:
+    case ir::Opcode::BRANCH:
+    case ir::Opcode::RETURN:
+      return false;
+    default:
+      return true;
+    }
+}
+
+}
+
+bool
+LoopInvariantCodeMotion::Run(ir::Function& function)
+{
+  function.compute_dominators();
+
+  auto changed{ false };
+
+  for (const auto& loop : function.find_loops())
+    {
+      if (loop.preheader == nullptr)
+        continue;
+
+      std::vector<bool> inside(function.block_count, false);
+      for (auto block : loop.blocks)
+        inside[block->id] = true;
+
+      auto& preheader{ loop.preheader->instructions };
+      auto moved{ 0 };
+      // Whether a print may run in the iteration before the instruction being looked at.
+      auto printed{ false };
+
+      // Blocks are visited in reverse postorder, so the operands of an instruction are moved before it, and
+      // the blocks that may run before it in an iteration are visited before its own.
+      for (auto block : loop.blocks)
+        {
+          auto every_iteration{ function.dominates(block, loop.latch) };
+          auto& instructions{ block->instructions };
+
+          for (auto it{ instructions.begin() }; it != instructions.end();)
+            {
+              auto& instruction{ **it };
+              printed |= instruction.op == ir::Opcode::PRINT;
+
+              if (!is_movable(instruction, every_iteration && !printed)
+                  || std::any_of(instruction.operands.begin(), instruction.operands.end(),
+                                 [&inside](const auto operand) { return inside[operand->block->id]; }))
+                {
+                  ++it;
+                  continue;
+                }
+
+              // Constants are materialized where they are used, so moving them saves nothing by itself.
+              if (instruction.op != ir::Opcode::CONST && instruction.op != ir::Opcode::STRING)
+                moved++;
+
+              instruction.block = loop.preheader;
+              preheader.insert(preheader.end() - 1, std::move(*it));
+              it = instructions.erase(it);
+              changed = true;
+            }
+        }
+
+      if (m_remarks != nullptr && moved > 0)
+        m_remarks->push_back(fmt::format("loop L{}: moved {} invariant instruction{} to L{}", loop.header->id,
+                                         moved, moved == 1 ? "" : "s", loop.preheader->id));
+    }
+
+  return changed;
+}
+
+}
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Passes.hpp"
+
+/// The number of instructions a loop body may grow to when it is unrolled.
+#define MAX_UNROLLED_SIZE 64
+
+namespace cat
+{
+
+namespace
+{
+
+using Values = std::unordered_map<ir::Instruction*, ir::Instruction*>;
+
+ir::Instruction*
+lookup(const Values& values, ir::Instruction* value)
+{
+  auto it{ values.find(value) };
+  return it == values.end() ? value : it->second;
+}
+
+/**
+ * Return the number of times the single block loop `loop` runs, if it
+ * counts with a phi from a constant up to another constant the way for
+ * loops do.
+ */
+std::optional<int>
+trip_count(const ir::Loop& loop)
+{
+  auto header{ loop.header };
+  auto terminator{ header->terminator() };
+  if (terminator->op != ir::Opcode::BRANCH || header->successors.front() != header)
+    return {};
+
+  auto condition{ terminator->operands[0] };
+  if (condition->op != ir::Opcode::LT || condition->operands[1]->op != ir::Opcode::CONST)
+    return {};
+
+  auto next{ condition->operands[0] };
+  if (next->op != ir::Opcode::ADD)
+    return {};
+
+  auto counter{ next->operands[0] };
+  auto step{ next->operands[1] };
+  if (counter->op == ir::Opcode::CONST)
+    std::swap(counter, step);
+
+  if (counter->op != ir::Opcode::PHI || counter->block != header || step->op != ir::Opcode::CONST
+      || step->imm != 1 || counter->operands[header->predecessor_index(header)] != next)
+    return {};
+
+  auto from{ counter->operands[header->predecessor_index(loop.preheader)] };
+  if (from->op != ir::Opcode::CONST)
+    return {};
+
+  // The body runs before the counter is tested for the first time.
+  return static_cast<int>(std::max<int64_t>(1, int64_t{ condition->operands[1]->imm } - from->imm));
+}
+
+/// Return the number of instructions that one iteration of the single block loop `header` runs.
+int
+body_size(const ir::BasicBlock& header)
+{
+  return std::count_if(header.instructions.begin(), header.instructions.end(), [](const auto& instruction) {
+    return instruction->op != ir::Opcode::PHI && instruction->op != ir::Opcode::CONST
+           && instruction->op != ir::Opcode::STRING && !instruction->is_terminator();
+  });
+}
+
+/**
+ * Append a copy of the body of the single block loop `header` to `copies`,
+ * for `block`, with its phis standing for `values`. Return the values of
+ * the phis in the iteration after it.
+ */
+Values
+copy_iteration(ir::Function& function, ir::BasicBlock* header, ir::BasicBlock* block, Values values,
+               std::vector<std::unique_ptr<ir::Instruction> >& copies)
+{
+  for (const auto& instruction : header->instructions)
+    {
+      if (instruction->op == ir::Opcode::PHI || instruction->is_terminator())
+        continue;
+
+      auto copy{ std::make_unique<ir::Instruction>(instruction->op, function.value_count++, block) };
+      copy->imm = instruction->imm;
+      for (auto operand : instruction->operands)
+        copy->operands.push_back(lookup(values, operand));
+
+      values[instruction.get()] = copy.get();
+      copies.push_back(std::move(copy));
+    }
+
+  Values next{};
+  auto latch{ header->predecessor_index(header) };
+
+  for (const auto& instruction : header->instructions)
+    if (instruction->op == ir::Opcode::PHI)
+      next[instruction.get()] = lookup(values, instruction->operands[latch]);
+
+  return next;
+}
+
+/// Return the values the phis of `header` take when the loop is entered from `preheader`.
+Values
+initial_values(const ir::BasicBlock& header, const ir::BasicBlock* preheader)
+{
+  Values values{};
+  auto entry{ header.predecessor_index(preheader) };
+
+  for (const auto& instruction : header.instructions)
+    if (instruction->op == ir::Opcode::PHI)
+      values[instruction.get()] = instruction->operands[entry];
+
+  return values;
+}
+
+/// Insert `copies` into `block` after its phis.
+void
+insert_after_phis(ir::BasicBlock* block, std::vector<std::unique_ptr<ir::Instruction> >& copies)
+{
+  auto& instructions{ block->instructions };
+  auto position{ std::find_if(instructions.begin(), instructions.end(),
+                              [](const auto& instruction) { return instruction->op != ir::Opcode::PHI; }) };
+
+  instructions.insert(position, std::make_move_iterator(copies.begin()), std::make_move_iterator(copies.end()));
+}
+
+/// Replace the single block loop `loop` by `trips` copies of its body.
+void
+unroll_fully(ir::Function& function, const ir::Loop& loop, int trips)
+{
+  auto header{ loop.header };
+  auto values{ initial_values(*header, loop.preheader) };
+  std::vector<std::unique_ptr<ir::Instruction> > copies{};
+
+  // The instructions of the loop run the last iteration, so the values used after the loop stay the same.
+  for (auto i = 1; i < trips; i++)
+    values = copy_iteration(function, header, header, std::move(values), copies);
+
+  insert_after_phis(header, copies);
+
+  auto terminator{ header->terminator() };
+  terminator->op = ir::Opcode::JUMP;
+  terminator->operands.clear();
+
+  header->successors.erase(header->successors.begin());
+  header->remove_predecessor(header);
+  function.replace(values);
+}
+
+/**
+ * Make the single block loop `loop` run `factor` iterations per trip
+ * around it, running the `trips % factor` iterations left over in its
+ * preheader.
+ */
+void
+unroll_partially(ir::Function& function, const ir::Loop& loop, int trips, int factor)
+{
+  auto header{ loop.header };
+
+  if (auto peeled{ trips % factor }; peeled > 0)
+    {
+      auto values{ initial_values(*header, loop.preheader) };
+      std::vector<std::unique_ptr<ir::Instruction> > copies{};
+
+      for (auto i = 0; i < peeled; i++)
+        values = copy_iteration(function, header, loop.preheader, std::move(values), copies);
+
+      auto& instructions{ loop.preheader->instructions };
+      instructions.insert(instructions.end() - 1, std::make_move_iterator(copies.begin()),
+                          std::make_move_iterator(copies.end()));
+
+      auto entry{ header->predecessor_index(loop.preheader) };
+      for (const auto& instruction : header->instructions)
+        if (instruction->op == ir::Opcode::PHI)
+          instruction->operands[entry] = values[instruction.get()];
+    }
+
+  // Again the instructions of the loop run the last iteration of every trip.
+  Values values{};
+  std::vector<std::unique_ptr<ir::Instruction> > copies{};
+
+  for (auto i = 1; i < factor; i++)
+    values = copy_iteration(function, header, header, std::move(values), copies);
+
+  for (const auto& instruction : header->instructions)
+    if (instruction->op != ir::Opcode::PHI)
+      for (auto& operand : instruction->operands)
+        operand = lookup(values, operand);
+
+  insert_after_phis(header, copies);
+}
+
+/// Return true if a phi of `header` is used outside of it.
+bool
+has_phis_used_outside(const ir::Function& function, const ir::BasicBlock* header)
+{
+  for (const auto& block : function.blocks)
+    if (block.get() != header)
+      for (const auto& instruction : block->instructions)
+        for (auto operand : instruction->operands)
+          if (operand->op == ir::Opcode::PHI && operand->block == header)
+            return true;
+
+  return false;
+}
+
+}
+
+bool
+LoopUnrolling::Run(ir::Function& function)
+{
+  function.compute_dominators();
+
+  auto changed{ false };
+
+  for (const auto& loop : function.find_loops())
+    {
+      auto header{ loop.header };
+      if (loop.blocks.size() != 1 || loop.preheader == nullptr || m_unrolled.count(header->id) != 0)
+        continue;
+
+      auto trips{ trip_count(loop) };
+      if (!trips)
+        continue;
+
+      auto size{ std::max(1, body_size(*header)) };
+
+      if (int64_t{ *trips } * size <= MAX_UNROLLED_SIZE)
+        {
+          unroll_fully(function, loop, *trips);
+          changed = true;
+
+          if (m_remarks != nullptr)
+            m_remarks->push_back(
+                fmt::format("loop L{}: unrolled fully, {} iteration{}", header->id, *trips, *trips == 1 ? "" : "s"));
+          continue;
+        }
+
+      // Keep the loop looping, and its body under the size limit.
+      auto factor{ std::min({ m_factor, *trips / 2, MAX_UNROLLED_SIZE / size }) };
+      if (factor < 2 || has_phis_used_outside(function, header))
+        continue;
+
+      unroll_partially(function, loop, *trips, factor);
+      m_unrolled.insert(header->id);
+      changed = true;
+
+      if (m_remarks == nullptr)
+        continue;
+
+      auto remark{ fmt::format("loop L{}: unrolled by {}", header->id, factor) };
+      if (auto peeled{ *trips % factor }; peeled > 0)
+        remark += fmt::format(", {} iteration{} run before it", peeled, peeled == 1 ? "" : "s");
+      m_remarks->push_back(std::move(remark));
+    }
+
+  return changed;
+}
+
+}
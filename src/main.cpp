@@ -1,8 +1,9 @@
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
-#include <fmt/core.h>
+#include <fmt/format.h>
 
 #include "cat.hpp"
 
@@ -38,6 +39,12 @@ main(int argc, char** argv)
 
   std::string filename{};
   bool run = false;
+  bool show_statistics = false;
+  bool show_remarks = false;
+
+  cat::Statistics statistics{};
+  std::vector<std::string> remarks{};
+  cat::Options options{};
 
   if (argc == 0)
     {
@@ -48,8 +55,13 @@ main(int argc, char** argv)
   int i{ 0 };
   for (; i < argc; i++)
     {
-      if (!std::strcmp(*argv, "-o"))
-        fout = fopen(*++argv, "w");
+      if (!std::strcmp(*argv, "-o") && i + 1 < argc)
+        {
+          // Binary so that --emit=obj writes the executable unchanged.
+          fout = fopen(*++argv, "wb");
+          argv++;
+          i++;
+        }
       else if (!std::strcmp(*argv, "-"))
         {
           filename = "stdin";
@@ -61,10 +73,85 @@ main(int argc, char** argv)
           run = true;
           argv++;
         }
+      else if (!std::strcmp(*argv, "--stats"))
+        {
+          show_statistics = true;
+          options.statistics = &statistics;
+          argv++;
+        }
+      else if (!std::strcmp(*argv, "--remarks"))
+        {
+          show_remarks = true;
+          options.remarks = &remarks;
+          argv++;
+        }
+      else if (!std::strncmp(*argv, "--unroll=", 9))
+        {
+          char* end{};
+          auto factor{ std::strtol(*argv + 9, &end, 10) };
+
+          if (*end != '\0' || factor < 1 || factor > 64)
+            {
+              fmt::print(stderr, "Expected a number from 1 to 64 in {}\n", *argv);
+              return 1;
+            }
+
+          options.unroll_factor = factor;
+          argv++;
+        }
+      else if (!std::strncmp(*argv, "--jobs=", 7))
+        {
+          char* end{};
+          auto jobs{ std::strtol(*argv + 7, &end, 10) };
+
+          if (*end != '\0' || jobs < 1 || jobs > 256)
+            {
+              fmt::print(stderr, "Expected a number from 1 to 256 in {}\n", *argv);
+              return 1;
+            }
+
+          options.parse_jobs = jobs;
+          argv++;
+        }
+      else if (!std::strcmp(*argv, "-O0"))
+        {
+          options.fold_constants = false;
+          options.eliminate_dead_code = false;
+          options.optimize = false;
+          options.peephole = false;
+          argv++;
+        }
+      else if (!std::strcmp(*argv, "--direct-syscalls"))
+        {
+          options.buffer_output = false;
+          argv++;
+        }
+      else if (!std::strcmp(*argv, "--emit=ir"))
+        {
+          options.emit = cat::Emit::IR;
+          argv++;
+        }
+      else if (!std::strcmp(*argv, "--emit=asm"))
+        {
+          options.emit = cat::Emit::ASSEMBLY;
+          argv++;
+        }
+      else if (!std::strcmp(*argv, "--emit=obj"))
+        {
+          options.emit = cat::Emit::OBJECT;
+          argv++;
+        }
       else
         break;
     }
 
+  // SPIM runs assembly, not an ELF image or the intermediate representation.
+  if (run && options.emit != cat::Emit::ASSEMBLY)
+    {
+      fmt::print(stderr, "--run only runs assembly, so it cannot be combined with --emit=ir or --emit=obj\n");
+      return 1;
+    }
+
   if (auto nargs{ argc - i }; nargs > 0)
     {
       filename = *argv;
@@ -77,17 +164,39 @@ main(int argc, char** argv)
   while (std::fgets(line, sizeof(line), fin) != NULL)
     program += line;
 
-  std::string result{};
-  auto ok{ cat::transpile(program, result, filename) };
+  fmt::memory_buffer result{};
+  auto ok{ cat::transpile(program, result, filename, options) };
+
+  if (show_statistics && ok)
+    {
+      fmt::print(stderr, "folded expressions:      {}\n", statistics.folded_expressions);
+      fmt::print(stderr, "removed statements:      {}\n", statistics.removed_statements);
+      fmt::print(stderr, "pruned branches:         {}\n", statistics.pruned_branches);
+      fmt::print(stderr, "dead code instructions:  {}\n", statistics.dead_code_instructions);
+      fmt::print(stderr, "instructions:            {}\n", statistics.instructions);
+      fmt::print(stderr, "spilled values:          {}\n", statistics.spilled_values);
+      if (!statistics.pass_changes.empty())
+        fmt::print(stderr, "pass changes:\n");
+      for (const auto& [pass, changes] : statistics.pass_changes)
+        fmt::print(stderr, "  {:42}{}\n", pass + ":", changes);
+      if (!statistics.peephole_hits.empty())
+        fmt::print(stderr, "peephole hits:\n");
+      for (const auto& [rule, hits] : statistics.peephole_hits)
+        fmt::print(stderr, "  {:23}{}\n", rule + ":", hits);
+    }
+
+  if (show_remarks && ok)
+    for (const auto& remark : remarks)
+      fmt::print(stderr, "remark: {}\n", remark);
 
   if (!run)
-    std::fputs(result.c_str(), fout);
+    std::fwrite(result.data(), 1, result.size(), fout);
   else if (ok)
     // We need to check if there were any errors before sending the
     // transpiler's output to SPIM.
-    std::cout << cat::execute(result);
+    std::cout << cat::execute(fmt::to_string(result));
   else
-    std::cout << result;
+    std::cout.write(result.data(), result.size());
 
   std::fclose(fout);
   std::fclose(fin);
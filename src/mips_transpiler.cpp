@@ -1,431 +1,1233 @@
+#include <algorithm>
 #include <cassert>
-#ifdef DEBUG
-#include <iostream>
-#endif
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
 
+#include <fmt/format.h>
+
+#include "Assembler.hpp"
 #include "Instruction.hpp"
 #include "MIPSTranspiler.hpp"
-#include "ast.hpp"
 
-#define AS_REGISTER(o) std::any_cast<register_t>(o)
-#define AS_NUMBER(o) static_cast<ast::Number*>(o)
+#define IS_CONSTANT(o) ((o)->op == ir::Opcode::CONST)
+#define IS_MATERIALIZED(o) ((o)->op == ir::Opcode::CONST || (o)->op == ir::Opcode::STRING)
+
+#define SERVICE_PRINT_INT 1
+#define SERVICE_PRINT_STRING 4
+#define SERVICE_PRINT_CHAR 11
 
-#define IS_NUMBER(o) ((o)->token().type() == TokenType::NUMBER)
+/// The number of characters the runtime collects before writing them.
+#define OUTPUT_BUFFER_SIZE 1024
+/// The characters of the longest int, "-2147483648".
+#define INT_DIGITS 11
+
+/// The offset from $gp of the start of the small data area, which $gp points 32K into.
+#define SMALL_DATA_START (-0x8000)
+/// The size of the small data area, all of which $gp reaches with a 16-bit offset.
+#define SMALL_DATA_SIZE 0x10000
 
 namespace cat
 {
 
-MIPSTranspiler::~MIPSTranspiler() { delete m_program; }
+namespace
+{
 
-/*
- * Scopes
- */
+const register_t zero{ register_t::name::ZERO };
+const register_t gp{ register_t::name::GP };
+const register_t ra{ register_t::name::RA };
 
-void
-MIPSTranspiler::enter_scope() noexcept
+bool
+same(const Location& a, const Location& b) noexcept
 {
-  m_scope = new Scope{ m_scope, *this };
+  return a.kind == b.kind && a.index == b.index;
 }
 
-void
-MIPSTranspiler::leave_scope() noexcept
+/// Split the contents of a string literal into its characters, keeping escape sequences whole.
+std::vector<std::string>
+characters(const std::string& literal)
 {
-  auto old_scope{ m_scope };
-  m_scope = old_scope->enclosing();
-  delete old_scope;
+  std::vector<std::string> characters{};
+
+  for (std::size_t i = 1; i + 1 < literal.size(); i++)
+    if (literal[i] == '\\' && i + 2 < literal.size())
+      {
+        characters.push_back(literal.substr(i, 2));
+        i++;
+      }
+    else
+      characters.emplace_back(1, literal[i]);
+
+  return characters;
 }
 
-void
-Scope::declare_and_initialize(const ast::Identifier& identifier, register_t rs) noexcept
-{
-  auto offset{ m_transpiler.stack().push() };
-  m_variables[identifier.name()] = offset;
-  m_transpiler.emit<Instruction::SW>(AS_REGISTER(rs), offset, register_t{ register_t::name::SP });
 }
 
-int
-Scope::find_variable(const ast::Identifier& identifier) const noexcept
+/*
+ * Locations
+ */
+
+RegisterPool::Handle
+MIPSTranspiler::use(const ir::Instruction* value)
 {
-  if (auto offset_ptr{ m_variables.find(identifier.name()) }; offset_ptr != m_variables.end())
-    return offset_ptr->second;
+  if (IS_CONSTANT(value) && value->imm == 0)
+    return zero;
 
-  if (m_enclosing != nullptr)
-    return m_enclosing->find_variable(identifier);
+  if (const auto& where{ location(value) }; where.kind == Location::Kind::REGISTER)
+    return register_t{ where.index };
 
-  return -1;
+  auto scratch{ m_scratch.acquire() };
+  load(scratch, value);
+  return scratch;
 }
 
-int
-MIPSTranspiler::Stack::push() noexcept
+register_t
+MIPSTranspiler::define(const ir::Instruction* value) const noexcept
 {
-  size_ += 4;
-  register_t stack_register{ register_t::name::SP };
-  m_transpiler.emit<Instruction::ADDI>(stack_register, stack_register, -4);
-  return size_ - 4;
+  if (const auto& where{ location(value) }; where.kind == Location::Kind::REGISTER)
+    return where.index;
+
+  // Results that are never used are still computed, since additions can trap.
+  return RegisterAllocator::first_scratch;
 }
 
 void
-MIPSTranspiler::Stack::pop() noexcept
+MIPSTranspiler::store(const ir::Instruction* value)
 {
-  size_ -= 4;
-  register_t stack_register{ register_t::name::SP };
-  m_transpiler.emit<Instruction::ADDI>(stack_register, stack_register, 4);
+  if (const auto& where{ location(value) }; where.kind == Location::Kind::MEMORY)
+    emit<Instruction::SW>(RegisterAllocator::first_scratch, slot_offset(where), gp);
 }
 
-/*
- * Register routines
- */
-
-register_t
-MIPSTranspiler::find_register() noexcept
+void
+MIPSTranspiler::load(register_t reg, const ir::Instruction* value)
 {
-  assert(!m_registers.all());
+  if (IS_CONSTANT(value))
+    {
+      load_constant(reg, value->imm);
+      return;
+    }
 
-  for (int register_number = register_t::min_value; register_number <= register_t::max_value;
-       register_number++)
+  if (value->op == ir::Opcode::STRING)
     {
-      if (int pos = register_number - register_t::min_value; !m_registers.test(pos))
-        {
-#ifdef DEBUG
-          std::cout << "Giving register number " << pos << "\n";
-#endif
-          m_registers |= 1 << pos; // Mark the register as being used
-          return { register_number };
-        }
+      emit<Instruction::LA>(reg, m_string_labels[value->imm]);
+      return;
     }
 
-  return { -1 };
+  const auto& where{ location(value) };
+  assert(where.kind != Location::Kind::NONE && "value used without a location");
+
+  if (where.kind == Location::Kind::MEMORY)
+    emit<Instruction::LW>(reg, slot_offset(where), gp);
+  else if (where.index != reg)
+    emit<Instruction::MOVE>(reg, register_t{ where.index });
 }
 
 void
-MIPSTranspiler::release_register(register_t reg)
+MIPSTranspiler::load_constant(register_t reg, int value)
+{
+  auto bits{ static_cast<uint32_t>(value) };
+
+  if (fits_immediate(value))
+    emit<Instruction::LI>(reg, value);
+  else if (bits <= 0xffff)
+    emit<Instruction::ORI>(reg, zero, bits);
+  else
+    {
+      emit<Instruction::LUI>(reg, bits >> 16);
+      if ((bits & 0xffff) != 0)
+        emit<Instruction::ORI>(reg, reg, bits & 0xffff);
+    }
+}
+
+int
+MIPSTranspiler::constant_cost(int value) noexcept
 {
-#ifdef DEBUG
-  std::cout << "Releasing register " << (reg - register_t::min_value) << "\n";
-#endif
-  m_registers &= ~(1 << (reg - register_t::min_value));
+  auto bits{ static_cast<uint32_t>(value) };
+  return fits_immediate(value) || bits <= 0xffff || (bits & 0xffff) == 0 ? 1 : 2;
 }
 
-void
-MIPSTranspiler::emit(const Instruction& instruction) noexcept
+bool
+MIPSTranspiler::fits_immediate(int value) noexcept
 {
-  emit(instruction.to_s());
+  return value >= std::numeric_limits<int16_t>::min() && value <= std::numeric_limits<int16_t>::max();
+}
+
+int
+MIPSTranspiler::slot_offset(const Location& where) noexcept
+{
+  return SMALL_DATA_START + where.index;
 }
 
 void
-MIPSTranspiler::emit(const std::string& s) noexcept
+MIPSTranspiler::emit(const Instruction& instruction)
 {
-  if (auto newline{ s.rfind('\n') }; newline != std::string::npos)
-    m_result += s;
-  else
-    m_result += s + "\n";
+  m_instructions.push_back(instruction);
 }
 
 /*
  * Labels
  */
 
-std::string
-MIPSTranspiler::generate_label(const std::string& prefix)
+int
+MIPSTranspiler::generate_label() noexcept
+{
+  return m_label_count++;
+}
+
+bool
+MIPSTranspiler::is_next(const ir::BasicBlock& block, const ir::BasicBlock* successor) const noexcept
 {
-  return (prefix == "" ? "L" : prefix) + std::to_string(m_label_count++);
+  return m_layout[target(successor)->id] == m_layout[block.id] + 1;
 }
 
-/*
- * Error routines
- */
+int
+MIPSTranspiler::label(const ir::BasicBlock* block) const noexcept
+{
+  return m_block_labels[target(block)->id];
+}
 
-MIPSTranspiler::RuntimeException
-MIPSTranspiler::undeclared_variable_error(ast::Identifier& identifier)
+bool
+MIPSTranspiler::is_forwarder(const ir::BasicBlock& block) const noexcept
 {
-  m_diagnostics.emplace_back("Unbound variable " + identifier.name(), identifier.token().span());
-  m_diagnostics.emplace_back(Diagnostic::Severity::HINT, "Maybe you forgot to declare the variable?\n\n"
-                                                         "\t let "
-                                                             + identifier.name() + " := ...");
-  return RuntimeException{};
+  return &block != m_function->entry() && block.instructions.size() == 1
+         && block.instructions.front()->op == ir::Opcode::JUMP && !copies_to_phis(block);
 }
 
-std::string
-MIPSTranspiler::Transpile()
+void
+MIPSTranspiler::analyze()
 {
-  emit("        .text");
-  emit("        .globl main");
-  emit("main:");
-  enter_scope();
-  if (m_program)
+  auto& function{ *m_function };
+
+  m_block_labels.resize(function.block_count);
+  m_needs_label.assign(function.block_count, false);
+  m_layout.resize(function.block_count);
+  m_targets.resize(function.block_count);
+
+  // Jumps to a block that only jumps on go straight to where it goes, so
+  // that the blocks splitting the back edge of a loop cost nothing once the
+  // phis of the loop share the registers of their operands.
+  for (const auto& block : function.blocks)
     {
-      try
-        {
-          m_program->Accept(*this);
-        }
-      catch (const RuntimeException& ex)
-        {
-        }
+      auto target{ block.get() };
+      for (std::size_t i = 0; i < function.blocks.size() && is_forwarder(*target); i++)
+        target = target->successors.front();
+      m_targets[block->id] = target;
+    }
+
+  for (const auto& block : function.blocks)
+    {
+      m_block_labels[block->id] = generate_label();
+      if (is_emitted(*block))
+        m_layout[block->id] = m_laid_out++;
+    }
+
+  // The spilled values come first in the small data area. The runtime keeps main's $ra and the count of
+  // buffered characters after them, so that they are aligned, with the buffer right after the count.
+  m_small_data_size = m_allocator->spill_area_size();
+  if (m_buffer_output && prints_often())
+    {
+      m_runtime.flush = generate_label();
+      m_runtime.put_int = generate_label();
+      m_runtime.put_string = generate_label();
+      m_runtime.put_char = generate_label();
+      m_runtime.saved_ra = SMALL_DATA_START + m_small_data_size;
+      m_runtime.buffer = m_runtime.saved_ra + 8;
+      m_runtime.digits = m_runtime.buffer + OUTPUT_BUFFER_SIZE + 1;
+      m_small_data_size = m_runtime.digits + INT_DIGITS + 1 - SMALL_DATA_START;
     }
-  leave_scope();
-  emit("jr   $ra");
 
-  if (m_string_literals.size() > 0)
-    emit("        .data");
+  if (m_small_data_size > SMALL_DATA_SIZE)
+    m_diagnostics.emplace_back("too many values are live at once to keep them in the small data area");
 
-  for (const auto& [label, literal] : m_string_literals)
-    emit(fmt::format("{}:     .asciiz {}", label, literal));
+  lay_out_strings();
 
-  return m_result;
+  for (const auto& block : function.blocks)
+    if (is_emitted(*block))
+      for (auto successor : block->successors)
+        if (!is_next(*block, successor))
+          m_needs_label[target(successor)->id] = true;
 }
 
 void
-MIPSTranspiler::VisitProgram(ast::Program& program)
+MIPSTranspiler::lay_out_strings()
 {
-  for (ast::Stmt* stmt : program.stmts())
+  const auto& strings{ m_function->strings };
+
+  for (std::size_t i = 0; i < strings.size(); i++)
+    m_string_labels.push_back(generate_label());
+
+  // Sorted by their reversed characters, a literal is a suffix of another only if it is a suffix of the
+  // one right after it.
+  std::vector<std::vector<std::string> > reversed{};
+  for (const auto& string : strings)
     {
-      assert(stmt != nullptr);
-      stmt->Accept(*this);
+      reversed.push_back(characters(string));
+      std::reverse(reversed.back().begin(), reversed.back().end());
     }
-}
-
-void
-MIPSTranspiler::VisitExprStmt(ast::ExprStmt& exprStmt)
-{
-  exprStmt.expr()->Accept(*this);
-}
 
-void
-MIPSTranspiler::VisitLetStmt(ast::LetStmt& letStmt)
-{
-  auto rs{ AS_REGISTER(letStmt.value().Accept(*this)) };
-  current_scope().declare_and_initialize(letStmt.identifier(), rs);
-  release_register(rs);
-}
+  std::vector<std::size_t> order(strings.size());
+  for (std::size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&reversed](auto a, auto b) { return reversed[a] < reversed[b]; });
 
-void
-MIPSTranspiler::VisitIfStmt(ast::IfStmt& ifStmt)
-{
-  // Generate code for the condition
-  auto rs{ AS_REGISTER(ifStmt.condition()->Accept(*this)) };
+  // The literal each one is the end of, if any.
+  std::vector<std::size_t> outer(strings.size(), strings.size());
+  for (std::size_t k = 0; k + 1 < order.size(); k++)
+    {
+      const auto& inner{ reversed[order[k]] };
+      const auto& other{ reversed[order[k + 1]] };
+      if (std::equal(inner.begin(), inner.end(), other.begin(), other.begin() + inner.size()))
+        outer[order[k]] = order[k + 1];
+    }
 
-  auto else_label{ generate_label() };
-  auto exit_if_stmt_label{ generate_label() };
+  std::vector<std::size_t> inner(strings.size(), strings.size());
+  for (std::size_t i = 0; i < strings.size(); i++)
+    if (outer[i] != strings.size())
+      inner[outer[i]] = i;
 
-  auto has_else_branch{ ifStmt.else_branch().size() > 0 };
+  // Each chain of literals is emitted where its longest one was, from the longest to the shortest.
+  for (std::size_t i = 0; i < strings.size(); i++)
+    {
+      if (outer[i] != strings.size())
+        continue;
 
-  // Enter a new scope for the if stmt
-  enter_scope();
+      for (auto k{ i }; k != strings.size(); k = inner[k])
+        {
+          if (inner[k] == strings.size())
+            {
+              m_data.push_back({ m_string_labels[k], strings[k] });
+              break;
+            }
+
+          // Only the characters before the inner literal.
+          auto length{ reversed[k].size() - reversed[inner[k]].size() };
+          std::string literal{ "\"" };
+          for (auto c{ reversed[k].rbegin() }; c != reversed[k].rbegin() + length; c++)
+            literal += *c;
+          literal += '"';
+
+          m_data.push_back({ m_string_labels[k], std::move(literal), 0, false });
+        }
+    }
+}
 
-  // Generate code for the if branch first.
+/*
+ * Selection
+ */
 
-  // Jump to the else branch if condition is falsey or over the if
-  // when the condition is false and there is not else branch.
+void
+MIPSTranspiler::generate()
+{
+  m_function->split_critical_edges();
+  m_allocator = std::make_unique<RegisterAllocator>(*m_function);
+  analyze();
+
+  // Calling the runtime overwrites $ra, which is saved in the small data area.
+  auto buffered{ m_runtime.flush != -1 };
+  if (buffered)
+    emit<Instruction::SW>(ra, m_runtime.saved_ra, gp);
+
+  for (const auto& block : m_function->blocks)
+    if (is_emitted(*block))
+      select(*block);
+
+  if (m_exit_label != -1)
+    emit<Instruction::LABEL>(m_exit_label);
+  if (buffered)
+    {
+      emit<Instruction::JAL>(m_runtime.flush);
+      emit<Instruction::LW>(ra, m_runtime.saved_ra, gp);
+    }
+  emit<Instruction::JR>(ra);
 
-  if (has_else_branch)
-    emit("beq " + std::string(rs) + ", $zero, " + else_label);
-  else
-    emit("beq " + std::string(rs) + ", $zero, " + exit_if_stmt_label);
+  if (buffered)
+    emit_runtime();
 
-  // We don't need the condition register anymore.
-  release_register(rs);
+  m_peephole.Run(m_instructions);
 
-  for (const auto& stmt : ifStmt.if_branch())
-    stmt->Accept(*this);
+  for (const auto& instruction : m_instructions)
+    if (instruction.op != Instruction::Opcode::LABEL)
+      m_instruction_count++;
+}
 
-  // Jump over the code for the else branch
-  if (has_else_branch)
-    emit("j " + exit_if_stmt_label);
+void
+MIPSTranspiler::Transpile(fmt::memory_buffer& out)
+{
+  generate();
 
-  // Now generate code for the else branch
-  if (has_else_branch)
-    emit(else_label + ":");
+  auto it{ std::back_inserter(out) };
 
-  for (const auto& stmt : ifStmt.else_branch())
-    stmt->Accept(*this);
+  fmt::format_to(it, "        .text\n        .globl main\nmain:\n");
+  write(out, m_instructions);
 
-  emit(exit_if_stmt_label + ":");
+  if (m_data.size() > 0)
+    fmt::format_to(it, "        .data\n");
+  write(out, m_data);
 
-  leave_scope();
+  if (m_small_data_size > 0)
+    fmt::format_to(it, "        .data {:#010x}\n        .space {}\n", Assembler::small_data_address,
+                   m_small_data_size);
 }
 
 void
-MIPSTranspiler::VisitForStmt(ast::ForStmt& stmt)
+MIPSTranspiler::Assemble(fmt::memory_buffer& out)
 {
+  generate();
+
+  Assembler{ m_instructions, m_data, static_cast<uint32_t>(m_small_data_size) }.Assemble(out);
 }
 
 void
-MIPSTranspiler::VisitPrintStmt(ast::PrintStmt& stmt)
+MIPSTranspiler::select(ir::BasicBlock& block)
 {
-  register_t v0{ register_t::name::V0 };
-  register_t a0{ register_t::name::A0 };
+  if (m_needs_label[block.id])
+    emit<Instruction::LABEL>(m_block_labels[block.id]);
 
-  uint32_t last_syscall{ 0 };
+  m_service = -1;
 
-  for (const auto& expr : stmt.exprs())
+  for (const auto& instruction : block.instructions)
     {
-      uint32_t syscall = expr->token().type() == TokenType::CHAR     ? 11
-                         : expr->token().type() == TokenType::STRING ? 4
-                                                                     : 1;
+      // Phis are written by their predecessors.
+      if (instruction->op == ir::Opcode::PHI)
+        continue;
 
-      if (last_syscall != syscall)
+      if (instruction->is_terminator())
         {
-          // Avoid loading the same immediate into $v0 every time.
-          emit<Instruction::LI>(v0, syscall);
-          last_syscall = syscall;
+          copy_to_phis(block);
+          select_terminator(block, *instruction);
         }
-
-      if (expr->token().type() == TokenType::CHAR || expr->token().type() == TokenType::NUMBER)
-        emit<Instruction::LI>(a0, AS_NUMBER(expr)->value());
       else
-        {
-          auto rs{ AS_REGISTER(expr->Accept(*this)) };
-          emit<Instruction::MOVE>(a0, rs);
-          release_register(rs);
-        }
+        select(*instruction);
 
-      emit("syscall");
+      assert(m_scratch.all_free() && "scratch register held past its instruction");
     }
 }
 
-std::any
-MIPSTranspiler::VisitNumber(ast::Number& expr)
+void
+MIPSTranspiler::select(ir::Instruction& instruction)
 {
-  auto r{ find_register() };
-  emit<Instruction::LI>(r, expr.value());
-  return r;
+  switch (instruction.op)
+    {
+    case ir::Opcode::CONST:
+    case ir::Opcode::STRING:
+      // Materialized where they are used.
+      return;
+    case ir::Opcode::ADD:
+    case ir::Opcode::SUB:
+    case ir::Opcode::MUL:
+      select_tiled(instruction);
+      break;
+    case ir::Opcode::LT:
+    case ir::Opcode::LTE:
+    case ir::Opcode::EQ:
+    case ir::Opcode::GT:
+    case ir::Opcode::GTE:
+      // Comparisons without a location are unused or selected with the branch testing them.
+      if (location(&instruction).kind == Location::Kind::NONE)
+        return;
+      select_tiled(instruction);
+      break;
+    case ir::Opcode::SELECT:
+      select_conditional_move(instruction);
+      return;
+    case ir::Opcode::PRINT:
+      select_print(instruction);
+      return;
+    default:
+      assert(false && "Unhandled instruction");
+    }
+
+  store(&instruction);
 }
 
-std::any
-MIPSTranspiler::VisitString(ast::String& expr)
+/*
+ * Tiles
+ *
+ * Every IR operation is covered by one of the tiles of its opcode. The
+ * cheapest tile whose patterns match the operands is chosen, counting the
+ * instructions that load the operands it takes in registers, so a constant
+ * that fits the immediate of a tile is free while one that does not costs
+ * the li, ori or lui and ori materializing it. Ties go to the tile listed
+ * first.
+ */
+
+const std::vector<MIPSTranspiler::Tile> MIPSTranspiler::tiles{
+  { ir::Opcode::ADD, Pattern::REGISTER, Pattern::SIGNED_IMMEDIATE, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      t.emit<Instruction::ADDI>(t.define(&instruction), rs, rhs->imm);
+    } },
+  { ir::Opcode::ADD, Pattern::REGISTER, Pattern::REGISTER, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      t.emit<Instruction::ADD>(t.define(&instruction), rs, rt);
+    } },
+  { ir::Opcode::SUB, Pattern::REGISTER, Pattern::NEGATED_IMMEDIATE, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      t.emit<Instruction::ADDI>(t.define(&instruction), rs, -rhs->imm);
+    } },
+  { ir::Opcode::SUB, Pattern::REGISTER, Pattern::REGISTER, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      t.emit<Instruction::SUB>(t.define(&instruction), rs, rt);
+    } },
+  { ir::Opcode::MUL, Pattern::REGISTER, Pattern::ZERO, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction*, const ir::Instruction*) {
+      t.emit<Instruction::MOVE>(t.define(&instruction), zero);
+    } },
+  { ir::Opcode::MUL, Pattern::REGISTER, Pattern::POWER_OF_TWO, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      t.select_multiplication(instruction, lhs, rhs->imm);
+    } },
+  { ir::Opcode::MUL, Pattern::REGISTER, Pattern::NEAR_POWER_OF_TWO, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      t.select_multiplication(instruction, lhs, rhs->imm);
+    } },
+  { ir::Opcode::MUL, Pattern::REGISTER, Pattern::REGISTER, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      t.emit<Instruction::MULT>(rs, rt);
+      t.emit<Instruction::MFLO>(t.define(&instruction));
+    } },
+  // x < c
+  { ir::Opcode::LT, Pattern::REGISTER, Pattern::SIGNED_IMMEDIATE, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      t.emit<Instruction::SLTI>(t.define(&instruction), rs, rhs->imm);
+    } },
+  // x < y
+  { ir::Opcode::LT, Pattern::REGISTER, Pattern::REGISTER, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      t.emit<Instruction::SLT>(t.define(&instruction), rs, rt);
+    } },
+  // (x <= c) = (x < c + 1)
+  { ir::Opcode::LTE, Pattern::REGISTER, Pattern::SUCCESSOR_IMMEDIATE, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      t.emit<Instruction::SLTI>(t.define(&instruction), rs, rhs->imm + 1);
+    } },
+  // (x <= y) = !(y < x)
+  { ir::Opcode::LTE, Pattern::REGISTER, Pattern::REGISTER, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      auto rd{ t.define(&instruction) };
+      t.emit<Instruction::SLT>(rd, rt, rs);
+      t.emit<Instruction::XORI>(rd, rd, 1);
+    } },
+  // (x > y) = (y < x)
+  { ir::Opcode::GT, Pattern::REGISTER, Pattern::REGISTER, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      t.emit<Instruction::SLT>(t.define(&instruction), rt, rs);
+    } },
+  // (x > c) = !(x < c + 1)
+  { ir::Opcode::GT, Pattern::REGISTER, Pattern::SUCCESSOR_IMMEDIATE, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rd{ t.define(&instruction) };
+      t.emit<Instruction::SLTI>(rd, rs, rhs->imm + 1);
+      t.emit<Instruction::XORI>(rd, rd, 1);
+    } },
+  // (x >= c) = !(x < c)
+  { ir::Opcode::GTE, Pattern::REGISTER, Pattern::SIGNED_IMMEDIATE, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rd{ t.define(&instruction) };
+      t.emit<Instruction::SLTI>(rd, rs, rhs->imm);
+      t.emit<Instruction::XORI>(rd, rd, 1);
+    } },
+  // (x >= y) = !(x < y)
+  { ir::Opcode::GTE, Pattern::REGISTER, Pattern::REGISTER, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      auto rd{ t.define(&instruction) };
+      t.emit<Instruction::SLT>(rd, rs, rt);
+      t.emit<Instruction::XORI>(rd, rd, 1);
+    } },
+  // (x == 0) = (x <u 1)
+  { ir::Opcode::EQ, Pattern::REGISTER, Pattern::ZERO, 1,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction*) {
+      auto rs{ t.use(lhs) };
+      t.emit<Instruction::SLTIU>(t.define(&instruction), rs, 1);
+    } },
+  // (x == c) = ((x ^ c) <u 1)
+  { ir::Opcode::EQ, Pattern::REGISTER, Pattern::UNSIGNED_IMMEDIATE, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rd{ t.define(&instruction) };
+      t.emit<Instruction::XORI>(rd, rs, rhs->imm);
+      t.emit<Instruction::SLTIU>(rd, rd, 1);
+    } },
+  // (x == y) = ((x ^ y) <u 1)
+  { ir::Opcode::EQ, Pattern::REGISTER, Pattern::REGISTER, 2,
+    [](MIPSTranspiler& t, ir::Instruction& instruction, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+      auto rs{ t.use(lhs) };
+      auto rt{ t.use(rhs) };
+      auto rd{ t.define(&instruction) };
+      t.emit<Instruction::XOR>(rd, rs, rt);
+      t.emit<Instruction::SLTIU>(rd, rd, 1);
+    } },
+};
+
+bool
+MIPSTranspiler::matches(Pattern pattern, const ir::Instruction* value) noexcept
 {
-  auto label{ generate_label() };
-  auto rd{ find_register() };
+  if (pattern == Pattern::REGISTER)
+    return true;
+  if (!IS_CONSTANT(value))
+    return false;
 
-  m_string_literals.emplace(label, expr.value());
-  emit<Instruction::LA>(rd, label);
+  auto c{ value->imm };
+  auto magnitude{ c < 0 ? 0u - static_cast<uint32_t>(c) : static_cast<uint32_t>(c) };
+  auto is_power_of_two{ [](uint32_t n) { return n != 0 && (n & (n - 1)) == 0; } };
 
-  return rd;
+  switch (pattern)
+    {
+    case Pattern::ZERO:
+      return c == 0;
+    case Pattern::SIGNED_IMMEDIATE:
+      return fits_immediate(c);
+    case Pattern::NEGATED_IMMEDIATE:
+      return c != std::numeric_limits<int>::min() && fits_immediate(-c);
+    case Pattern::SUCCESSOR_IMMEDIATE:
+      return c != std::numeric_limits<int>::max() && fits_immediate(c + 1);
+    case Pattern::UNSIGNED_IMMEDIATE:
+      return c >= 0 && c <= 0xffff;
+    case Pattern::POWER_OF_TWO:
+      return is_power_of_two(magnitude);
+    case Pattern::NEAR_POWER_OF_TWO:
+      return magnitude > 2 && (is_power_of_two(magnitude - 1) || is_power_of_two(magnitude + 1));
+    default:
+      return false;
+    }
 }
 
-std::any
-MIPSTranspiler::VisitIdentifier(ast::Identifier& identifier)
+int
+MIPSTranspiler::operand_cost(Pattern pattern, const ir::Instruction* value) const noexcept
 {
-  if (auto offset{ current_scope().find_variable(identifier) }; offset != -1)
-    {
-      auto rs{ find_register() };
-      emit<Instruction::LW>(rs, offset, register_t{ register_t::name::SP });
-      return rs;
-    }
+  if (pattern == Pattern::POWER_OF_TWO || pattern == Pattern::NEAR_POWER_OF_TWO)
+    // Multiplying by a negative factor negates the product.
+    return value->imm < 0 ? 1 : 0;
+
+  if (pattern != Pattern::REGISTER)
+    return 0;
 
-  throw undeclared_variable_error(identifier);
+  if (IS_CONSTANT(value))
+    return value->imm == 0 ? 0 : constant_cost(value->imm);
+  if (value->op == ir::Opcode::STRING)
+    return 2;
+
+  return location(value).kind == Location::Kind::MEMORY ? 1 : 0;
 }
 
-std::any
-MIPSTranspiler::VisitAddExpr(ast::AddExpr& expr)
+void
+MIPSTranspiler::select_tiled(ir::Instruction& instruction)
 {
-  register_t lhs{ AS_REGISTER(expr.lhs()->Accept(*this)) };
+  // Swapping the operands of a comparison mirrors it.
+  auto mirrored{ [](ir::Opcode op) -> std::optional<ir::Opcode> {
+    switch (op)
+      {
+      case ir::Opcode::ADD:
+      case ir::Opcode::MUL:
+      case ir::Opcode::EQ:
+        return op;
+      case ir::Opcode::LT:
+        return ir::Opcode::GT;
+      case ir::Opcode::LTE:
+        return ir::Opcode::GTE;
+      case ir::Opcode::GT:
+        return ir::Opcode::LT;
+      case ir::Opcode::GTE:
+        return ir::Opcode::LTE;
+      default:
+        return std::nullopt;
+      }
+  } };
+
+  const Tile* best{};
+  const ir::Instruction* best_lhs{};
+  const ir::Instruction* best_rhs{};
+  auto best_cost{ std::numeric_limits<int>::max() };
+
+  auto consider{ [&](ir::Opcode op, const ir::Instruction* lhs, const ir::Instruction* rhs) {
+    for (const auto& tile : tiles)
+      {
+        if (tile.op != op || !matches(tile.lhs, lhs) || !matches(tile.rhs, rhs))
+          continue;
+
+        auto cost{ tile.cost + operand_cost(tile.lhs, lhs) + operand_cost(tile.rhs, rhs) };
+        if (cost < best_cost)
+          {
+            best = &tile;
+            best_lhs = lhs;
+            best_rhs = rhs;
+            best_cost = cost;
+          }
+      }
+  } };
+
+  auto lhs{ instruction.operands[0] };
+  auto rhs{ instruction.operands[1] };
+
+  consider(instruction.op, lhs, rhs);
+  if (auto op{ mirrored(instruction.op) })
+    consider(*op, rhs, lhs);
+
+  assert(best != nullptr && "no tile covers the instruction");
+  best->emit(*this, instruction, best_lhs, best_rhs);
+}
 
-  if (IS_NUMBER(expr.rhs()))
+void
+MIPSTranspiler::select_multiplication(ir::Instruction& instruction, const ir::Instruction* value, int factor)
+{
+  // Multiplications wrap around, so the additions must not trap.
+  auto magnitude{ factor < 0 ? 0u - static_cast<uint32_t>(factor) : static_cast<uint32_t>(factor) };
+  auto is_power_of_two{ [](uint32_t n) { return n != 0 && (n & (n - 1)) == 0; } };
+  auto log2{ [](uint32_t n) {
+    auto k{ 0 };
+    while (n >>= 1)
+      k++;
+    return k;
+  } };
+
+  auto rd{ define(&instruction) };
+  auto rs{ use(value) };
+
+  if (is_power_of_two(magnitude))
     {
-      emit<Instruction::ADDI>(lhs, lhs, AS_NUMBER(expr.rhs())->value());
+      if (magnitude == 1)
+        {
+          if (factor > 0)
+            load(rd, value);
+          else
+            emit<Instruction::SUBU>(rd, zero, rs);
+          return;
+        }
+
+      emit<Instruction::SLL>(rd, rs, log2(magnitude));
     }
   else
     {
-      register_t rhs{ AS_REGISTER(expr.rhs()->Accept(*this)) };
-      emit<Instruction::ADD>(lhs, lhs, rhs);
-      release_register(rhs);
+      // x * (2^k + 1) = (x << k) + x and x * (2^k - 1) = (x << k) - x
+      auto plus{ is_power_of_two(magnitude - 1) };
+      auto shifted{ m_scratch.acquire() };
+
+      emit<Instruction::SLL>(shifted, rs, log2(plus ? magnitude - 1 : magnitude + 1));
+      if (plus)
+        emit<Instruction::ADDU>(rd, shifted, rs);
+      else
+        emit<Instruction::SUBU>(rd, shifted, rs);
     }
 
-  return lhs;
+  if (factor < 0)
+    emit<Instruction::SUBU>(rd, zero, rd);
 }
 
-std::any
-MIPSTranspiler::VisitSubExpr(ast::SubExpr& expr)
+void
+MIPSTranspiler::select_conditional_move(ir::Instruction& instruction)
 {
-  register_t lhs{ AS_REGISTER(expr.lhs()->Accept(*this)) };
+  auto condition{ instruction.operands[0] };
+  auto if_true{ instruction.operands[1] };
+  auto if_false{ instruction.operands[2] };
+
+  auto register_of{ [this](const ir::Instruction* value) -> std::optional<register_t> {
+    if (IS_CONSTANT(value) && value->imm == 0)
+      return zero;
+    if (const auto& where{ location(value) }; where.kind == Location::Kind::REGISTER)
+      return register_t{ where.index };
+    return std::nullopt;
+  } };
+
+  if (IS_CONSTANT(condition))
+    {
+      load(define(&instruction), condition->imm != 0 ? if_true : if_false);
+      store(&instruction);
+      return;
+    }
+
+  auto rc{ use(condition) };
+  const auto& where{ location(&instruction) };
+
+  // A result with a register of its own holds one operand while the other one is moved over it.
+  if (where.kind == Location::Kind::REGISTER && register_t{ where.index } != static_cast<register_t>(rc))
+    {
+      register_t rd{ where.index };
+
+      if (register_of(if_true) == rd)
+        emit<Instruction::MOVZ>(rd, use(if_false), rc);
+      else
+        {
+          load(rd, if_false);
+          emit<Instruction::MOVN>(rd, use(if_true), rc);
+        }
+      return;
+    }
 
-  if (IS_NUMBER(expr.rhs()))
+  // Otherwise the result is computed in a scratch register, leaving one operand where it is.
+  auto result{ m_scratch.acquire() };
+
+  if (auto rt{ register_of(if_true) }; rt)
+    {
+      load(result, if_false);
+      emit<Instruction::MOVN>(result, *rt, rc);
+    }
+  else if (auto rf{ register_of(if_false) }; rf)
     {
-      emit<Instruction::ADDI>(lhs, lhs, -AS_NUMBER(expr.rhs())->value());
+      load(result, if_true);
+      emit<Instruction::MOVZ>(result, *rf, rc);
+    }
+  else if (register_of(condition))
+    {
+      load(result, if_false);
+      emit<Instruction::MOVN>(result, use(if_true), rc);
     }
   else
     {
-      register_t rhs{ AS_REGISTER(expr.rhs()->Accept(*this)) };
-      emit<Instruction::SUB>(lhs, lhs, rhs);
-      release_register(rhs);
+      // The condition already takes the other scratch register, so the operands are loaded one after the
+      // other around a branch.
+      auto skip{ generate_label() };
+      load(result, if_false);
+      emit<Instruction::BEQ>(rc, zero, skip);
+      load(result, if_true);
+      emit<Instruction::LABEL>(skip);
     }
 
-  return lhs;
+  if (where.kind == Location::Kind::REGISTER)
+    emit<Instruction::MOVE>(register_t{ where.index }, result);
+  else if (where.kind == Location::Kind::MEMORY)
+    emit<Instruction::SW>(result, slot_offset(where), gp);
 }
 
-std::any
-MIPSTranspiler::VisitMultExpr(ast::MultExpr& expr)
+void
+MIPSTranspiler::select_print(ir::Instruction& instruction)
 {
-  register_t lhs{ AS_REGISTER(expr.lhs()->Accept(*this)) };
-  register_t rhs{ AS_REGISTER(expr.rhs()->Accept(*this)) };
+  register_t v0{ register_t::name::V0 };
+
+  if (m_runtime.flush != -1)
+    {
+      load(register_t::name::A0, instruction.operands[0]);
+
+      switch (instruction.imm)
+        {
+        case SERVICE_PRINT_INT:
+          emit<Instruction::JAL>(m_runtime.put_int);
+          break;
+        case SERVICE_PRINT_STRING:
+          emit<Instruction::JAL>(m_runtime.put_string);
+          break;
+        case SERVICE_PRINT_CHAR:
+          emit<Instruction::JAL>(m_runtime.put_char);
+          break;
+        default:
+          assert(false && "Unhandled print service");
+        }
 
-  emit<Instruction::MULT>(lhs, rhs);
-  emit<Instruction::MFLO>(lhs);
+      // The runtime uses $v0 for its own syscalls.
+      m_service = -1;
+      return;
+    }
 
-  release_register(rhs);
-  return lhs;
+  if (m_service != instruction.imm)
+    {
+      // Avoid loading the same immediate into $v0 every time.
+      emit<Instruction::LI>(v0, instruction.imm);
+      m_service = instruction.imm;
+    }
+
+  load(register_t::name::A0, instruction.operands[0]);
+  emit<Instruction::SYSCALL>();
 }
 
-std::any
-MIPSTranspiler::VisitAssignExpr(ast::AssignExpr& expr)
+bool
+MIPSTranspiler::prints_often() const noexcept
 {
-  auto identifier{ static_cast<ast::Identifier*>(expr.lhs()) };
+  auto prints{ 0 };
+  auto loops{ false };
 
-  if (auto offset{ current_scope().find_variable(*identifier) }; offset != -1)
+  for (const auto& block : m_function->blocks)
     {
-      auto rs{ AS_REGISTER(expr.rhs()->Accept(*this)) };
+      if (!is_emitted(*block))
+        continue;
 
-      emit<Instruction::SW>(rs, offset, register_t{ register_t::name::SP });
+      for (const auto& instruction : block->instructions)
+        if (instruction->op == ir::Opcode::PRINT)
+          prints++;
 
-      return rs;
+      // Loops are laid out with an edge back to their header.
+      for (auto successor : block->successors)
+        loops |= m_layout[target(successor)->id] <= m_layout[block->id];
     }
 
-  throw undeclared_variable_error(*identifier);
+  // A print may run more than once in a function with a loop.
+  return prints > 1 || (prints == 1 && loops);
 }
 
-std::any
-MIPSTranspiler::VisitComparisonExpr(ast::ComparisonExpr& expr)
+bool
+MIPSTranspiler::copies_to_phis(const ir::BasicBlock& block) const noexcept
 {
-  auto rs{ AS_REGISTER(expr.lhs()->Accept(*this)) };
-  auto rt{ AS_REGISTER(expr.rhs()->Accept(*this)) };
-  auto rd{ find_register() };
+  for (auto successor : block.successors)
+    {
+      auto index{ successor->predecessor_index(&block) };
 
-  // FIXME: Currently there is no way to check if the two operands are correct.
+      for (const auto& instruction : successor->instructions)
+        {
+          if (instruction->op != ir::Opcode::PHI)
+            break;
+
+          auto operand{ instruction->operands[index] };
+          const auto& destination{ location(instruction.get()) };
+
+          if (destination.kind == Location::Kind::NONE || operand == instruction.get())
+            continue;
+          if (IS_MATERIALIZED(operand) || !same(destination, location(operand)))
+            return true;
+        }
+    }
+
+  return false;
+}
 
-  switch (expr.token().type())
+void
+MIPSTranspiler::copy_to_phis(ir::BasicBlock& block)
+{
+  struct Move
+  {
+    Location destination;
+    Location source;
+  };
+
+  auto copy{ [this](const Location& destination, const Location& source) {
+    if (destination.kind == Location::Kind::REGISTER)
+      {
+        if (source.kind == Location::Kind::REGISTER)
+          emit<Instruction::MOVE>(register_t{ destination.index }, register_t{ source.index });
+        else
+          emit<Instruction::LW>(register_t{ destination.index }, slot_offset(source), gp);
+        return;
+      }
+
+    if (source.kind == Location::Kind::REGISTER)
+      {
+        emit<Instruction::SW>(register_t{ source.index }, slot_offset(destination), gp);
+        return;
+      }
+
+    auto scratch{ m_scratch.acquire() };
+    emit<Instruction::LW>(scratch, slot_offset(source), gp);
+    emit<Instruction::SW>(scratch, slot_offset(destination), gp);
+  } };
+
+  for (auto successor : block.successors)
     {
-    case TokenType::LT:
-      // x < y
-      emit<Instruction::SLT>(rd, rs, rt);
-      break;
-    case TokenType::LTE:
-      // (x <= y) = !(y < x)
-      emit<Instruction::SLT>(rd, rt, rs);
-      emit<Instruction::XORI>(rd, rd, 1);
-      break;
-    case TokenType::EQ:
-      emit<Instruction::SUBU>(rd, rs, rt);
-      emit<Instruction::SLTU>(rd, register_t{ register_t::name::ZERO }, rd);
-      emit<Instruction::XORI>(rd, rd, 1);
-      break;
-    case TokenType::GT:
-      // (x > y) = (y < x)
-      emit<Instruction::SLT>(rd, rt, rs);
+      auto index{ successor->predecessor_index(&block) };
+      std::vector<Move> moves{};
+      std::vector<ir::Instruction*> materialized{};
+
+      for (const auto& instruction : successor->instructions)
+        {
+          if (instruction->op != ir::Opcode::PHI)
+            break;
+
+          auto operand{ instruction->operands[index] };
+          const auto& destination{ location(instruction.get()) };
+
+          if (destination.kind == Location::Kind::NONE || operand == instruction.get())
+            continue;
+
+          if (IS_MATERIALIZED(operand))
+            materialized.push_back(instruction.get());
+          else if (!same(destination, location(operand)))
+            moves.push_back({ destination, location(operand) });
+        }
+
+      // The copies happen at the same time: a location is only overwritten
+      // once no other copy reads it, and cycles are broken by saving one of
+      // their locations in a scratch register. Every copy reading the saved
+      // location is done before the next cycle is broken.
+      std::optional<RegisterPool::Handle> saved{};
+
+      while (!moves.empty())
+        {
+          auto ready{ std::find_if(moves.begin(), moves.end(), [&moves](const Move& move) {
+            return std::none_of(moves.begin(), moves.end(),
+                                [&move](const Move& other) { return same(other.source, move.destination); });
+          }) };
+
+          if (ready != moves.end())
+            {
+              copy(ready->destination, ready->source);
+              moves.erase(ready);
+              continue;
+            }
+
+          saved.reset();
+          saved.emplace(m_scratch.acquire());
+
+          Location temporary{ Location::Kind::REGISTER, register_t{ *saved } };
+          auto cycle{ moves.front().destination };
+          copy(temporary, cycle);
+
+          for (auto& move : moves)
+            if (same(move.source, cycle))
+              move.source = temporary;
+        }
+
+      // Constants overwrite no source, so they are copied last.
+      for (auto phi : materialized)
+        {
+          auto reg{ define(phi) };
+          load(reg, phi->operands[index]);
+          store(phi);
+        }
+    }
+}
+
+void
+MIPSTranspiler::select_terminator(ir::BasicBlock& block, ir::Instruction& instruction)
+{
+  switch (instruction.op)
+    {
+    case ir::Opcode::RETURN:
+      if (m_layout[block.id] + 1 != m_laid_out)
+        {
+          if (m_exit_label == -1)
+            m_exit_label = generate_label();
+          emit<Instruction::J>(m_exit_label);
+        }
       break;
-    case TokenType::GTE:
-      // (x >= y) = !(x < y)
-      emit<Instruction::SLT>(rd, rs, rt);
-      emit<Instruction::XORI>(rd, rd, 1);
+    case ir::Opcode::JUMP:
+      if (!is_next(block, block.successors.front()))
+        emit<Instruction::J>(label(block.successors.front()));
       break;
+    case ir::Opcode::BRANCH:
+      {
+        auto if_block{ block.successors[0] };
+        auto else_block{ block.successors[1] };
+        auto condition{ instruction.operands[0] };
+
+        // Both edges can lead to the same block once the blocks that only jump on are skipped.
+        if (target(if_block) == target(else_block))
+          {
+            if (!is_next(block, if_block))
+              emit<Instruction::J>(label(if_block));
+            break;
+          }
+
+        // When the condition is known, only the branch that runs is reached.
+        if (IS_CONSTANT(condition))
+          {
+            auto taken{ condition->imm ? if_block : else_block };
+            if (!is_next(block, taken))
+              emit<Instruction::J>(label(taken));
+            break;
+          }
+
+        if (ir::is_comparison(condition->op) && location(condition).kind == Location::Kind::NONE)
+          {
+            if (is_next(block, else_block))
+              select_branch(*condition, true, label(if_block));
+            else
+              {
+                select_branch(*condition, false, label(else_block));
+                if (!is_next(block, if_block))
+                  emit<Instruction::J>(label(if_block));
+              }
+            break;
+          }
+
+        auto rs{ use(condition) };
+
+        if (is_next(block, else_block))
+          emit<Instruction::BNE>(rs, zero, label(if_block));
+        else
+          {
+            emit<Instruction::BEQ>(rs, zero, label(else_block));
+            if (!is_next(block, if_block))
+              emit<Instruction::J>(label(if_block));
+          }
+        break;
+      }
     default:
-      assert(false && "Unhandled comparison operator");
+      assert(false && "Unhandled terminator");
     }
+}
 
-  release_register(rs);
-  release_register(rt);
+void
+MIPSTranspiler::select_branch(const ir::Instruction& comparison, bool when, int label)
+{
+  auto lhs{ comparison.operands[0] };
+  auto rhs{ comparison.operands[1] };
+
+  if (comparison.op == ir::Opcode::EQ)
+    {
+      auto rs{ use(lhs) };
+      auto rt{ use(rhs) };
+
+      if (when)
+        emit<Instruction::BEQ>(rs, rt, label);
+      else
+        emit<Instruction::BNE>(rs, rt, label);
+      return;
+    }
 
-  return rd;
+  // Every other comparison is lhs < rhs, possibly negated: x > y = y < x,
+  // x >= y = !(x < y) and x <= y = !(y < x).
+  if (comparison.op == ir::Opcode::GT || comparison.op == ir::Opcode::LTE)
+    std::swap(lhs, rhs);
+
+  auto negated{ comparison.op == ir::Opcode::GTE || comparison.op == ir::Opcode::LTE };
+  auto if_less{ when != negated };
+
+  // Comparisons against zero have their own branches.
+  if (IS_CONSTANT(rhs) && rhs->imm == 0)
+    {
+      auto rs{ use(lhs) };
+
+      if (if_less)
+        emit<Instruction::BLTZ>(rs, label);
+      else
+        emit<Instruction::BGEZ>(rs, label);
+      return;
+    }
+
+  if (IS_CONSTANT(lhs) && lhs->imm == 0)
+    {
+      auto rs{ use(rhs) };
+
+      if (if_less)
+        emit<Instruction::BGTZ>(rs, label);
+      else
+        emit<Instruction::BLEZ>(rs, label);
+      return;
+    }
+
+  // The operands are read before the flag is written, so it can reuse a scratch register.
+  register_t flag{ RegisterAllocator::first_scratch };
+
+  if (IS_CONSTANT(rhs) && fits_immediate(rhs->imm))
+    emit<Instruction::SLTI>(flag, use(lhs), rhs->imm);
+  else
+    {
+      auto rs{ use(lhs) };
+      auto rt{ use(rhs) };
+      emit<Instruction::SLT>(flag, rs, rt);
+    }
+
+  if (if_less)
+    emit<Instruction::BNE>(flag, zero, label);
+  else
+    emit<Instruction::BEQ>(flag, zero, label);
+}
+
+/*
+ * Runtime
+ */
+
+void
+MIPSTranspiler::emit_runtime()
+{
+  register_t v0{ register_t::name::V0 };
+  register_t v1{ register_t::name::V1 };
+  register_t a0{ register_t::name::A0 };
+  register_t a1{ register_t::name::A1 };
+  register_t a2{ register_t::name::A2 };
+  register_t a3{ register_t::name::A3 };
+  register_t t8{ register_t::name::T8 };
+  register_t t9{ register_t::name::T9 };
+
+  // The count of buffered characters is the word before the buffer.
+  auto count{ -4 };
+
+  // flush: write the buffered characters, if any.
+  auto flushed{ generate_label() };
+  emit<Instruction::LABEL>(m_runtime.flush);
+  emit<Instruction::ADDI>(t9, gp, m_runtime.buffer);
+  emit<Instruction::LW>(v1, count, t9);
+  emit<Instruction::BEQ>(v1, zero, flushed);
+  emit<Instruction::ADDU>(t8, t9, v1);
+  emit<Instruction::SB>(zero, 0, t8);
+  emit<Instruction::SW>(zero, count, t9);
+  emit<Instruction::LI>(v0, SERVICE_PRINT_STRING);
+  emit<Instruction::MOVE>(a0, t9);
+  emit<Instruction::SYSCALL>();
+  emit<Instruction::LABEL>(flushed);
+  emit<Instruction::JR>(ra);
+
+  // put_char: append $a0, and flush when the buffer is full. The flush returns to the caller.
+  emit<Instruction::LABEL>(m_runtime.put_char);
+  emit<Instruction::ADDI>(t9, gp, m_runtime.buffer);
+  emit<Instruction::LW>(v1, count, t9);
+  emit<Instruction::ADDU>(t8, t9, v1);
+  emit<Instruction::SB>(a0, 0, t8);
+  emit<Instruction::ADDI>(v1, v1, 1);
+  emit<Instruction::SW>(v1, count, t9);
+  emit<Instruction::SLTI>(t8, v1, OUTPUT_BUFFER_SIZE);
+  emit<Instruction::BEQ>(t8, zero, m_runtime.flush);
+  emit<Instruction::JR>(ra);
+
+  // put_int: write the digits of $a0 backwards from the end of their area, then put them as a string.
+  auto digit{ generate_label() };
+  auto positive{ generate_label() };
+  emit<Instruction::LABEL>(m_runtime.put_int);
+  emit<Instruction::ADDI>(a2, gp, m_runtime.digits + INT_DIGITS);
+  emit<Instruction::MOVE>(v1, a0);
+  emit<Instruction::BGEZ>(a0, digit);
+  emit<Instruction::SUBU>(v1, zero, a0);
+  emit<Instruction::LABEL>(digit);
+  emit<Instruction::LI>(t8, 10);
+  emit<Instruction::DIVU>(v1, t8);
+  emit<Instruction::MFHI>(t9);
+  emit<Instruction::MFLO>(v1);
+  emit<Instruction::ADDI>(t9, t9, '0');
+  emit<Instruction::ADDI>(a2, a2, -1);
+  emit<Instruction::SB>(t9, 0, a2);
+  emit<Instruction::BNE>(v1, zero, digit);
+  emit<Instruction::BGEZ>(a0, positive);
+  emit<Instruction::LI>(t9, '-');
+  emit<Instruction::ADDI>(a2, a2, -1);
+  emit<Instruction::SB>(t9, 0, a2);
+  emit<Instruction::LABEL>(positive);
+  emit<Instruction::MOVE>(a0, a2);
+
+  // put_string: copy the string at $a0 into the buffer, flushing it whenever it fills up. It follows
+  // put_int, which falls through into it.
+  auto copy{ generate_label() };
+  auto copied{ generate_label() };
+  emit<Instruction::LABEL>(m_runtime.put_string);
+  emit<Instruction::ADDI>(t9, gp, m_runtime.buffer);
+  emit<Instruction::LW>(v1, count, t9);
+  emit<Instruction::LABEL>(copy);
+  emit<Instruction::LBU>(t8, 0, a0);
+  emit<Instruction::BEQ>(t8, zero, copied);
+  emit<Instruction::ADDU>(a1, t9, v1);
+  emit<Instruction::SB>(t8, 0, a1);
+  emit<Instruction::ADDI>(v1, v1, 1);
+  emit<Instruction::ADDI>(a0, a0, 1);
+  emit<Instruction::SLTI>(a1, v1, OUTPUT_BUFFER_SIZE);
+  emit<Instruction::BNE>(a1, zero, copy);
+  emit<Instruction::SW>(v1, count, t9);
+  emit<Instruction::MOVE>(a2, a0);
+  emit<Instruction::MOVE>(a3, ra);
+  emit<Instruction::JAL>(m_runtime.flush);
+  emit<Instruction::MOVE>(ra, a3);
+  emit<Instruction::MOVE>(a0, a2);
+  emit<Instruction::ADDI>(t9, gp, m_runtime.buffer);
+  emit<Instruction::MOVE>(v1, zero);
+  emit<Instruction::J>(copy);
+  emit<Instruction::LABEL>(copied);
+  emit<Instruction::SW>(v1, count, t9);
+  emit<Instruction::JR>(ra);
 }
 
 }
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <charconv>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
 #include "Parser.hpp"
 #include "ast.hpp"
@@ -183,6 +190,129 @@ Parser::Parse()
   return program;
 };
 
+std::optional<std::vector<Parser::TokenRange> >
+Parser::top_level_statements() const noexcept
+{
+  std::vector<TokenRange> ranges{};
+
+  // Statements end with a '.', except for if statements, which end with
+  // 'end', and for statements, which end with '}'. Both of them nest.
+  int depth{ 0 };
+  std::vector<Token>::size_type start{ 0 };
+
+  for (std::vector<Token>::size_type i = 0; i < m_tokens.size(); i++)
+    {
+      const auto& token{ m_tokens[i] };
+      auto ends_statement{ false };
+
+      switch (token.type())
+        {
+        case TokenType::IDENTIFIER:
+          if (token.is("if"))
+            depth++;
+          else if (token.is("end"))
+            ends_statement = --depth == 0;
+          break;
+        case TokenType::LBRACE:
+          depth++;
+          break;
+        case TokenType::RBRACE:
+          ends_statement = --depth == 0;
+          break;
+        case TokenType::DOT:
+          ends_statement = depth == 0;
+          break;
+        case TokenType::END:
+          if (depth != 0 || start != i)
+            return std::nullopt;
+          return ranges;
+        default:
+          break;
+        }
+
+      if (depth < 0)
+        return std::nullopt;
+
+      if (ends_statement)
+        {
+          ranges.emplace_back(start, i + 1);
+          start = i + 1;
+        }
+    }
+
+  return std::nullopt;
+}
+
+std::unique_ptr<Program>
+Parser::ParseParallel(unsigned jobs)
+{
+  if (jobs <= 1 || m_tokens.size() < parallel_threshold)
+    return Parse();
+
+  auto ranges{ top_level_statements() };
+  if (!ranges.has_value() || ranges->size() < jobs)
+    return Parse();
+
+  // Split the statements into contiguous batches of roughly the same number of tokens.
+  std::vector<TokenRange> batches{};
+  auto tokens_per_batch{ m_tokens.size() / jobs };
+  auto batch_start{ ranges->front().first };
+
+  for (const auto& [start, end] : *ranges)
+    {
+      if (end - batch_start >= tokens_per_batch && batches.size() + 1 < jobs)
+        {
+          batches.emplace_back(batch_start, end);
+          batch_start = end;
+        }
+    }
+
+  if (batch_start != ranges->back().second)
+    batches.emplace_back(batch_start, ranges->back().second);
+
+  std::vector<std::unique_ptr<Program> > programs(batches.size());
+  std::vector<std::vector<Diagnostic> > diagnostics(batches.size());
+  std::vector<std::exception_ptr> exceptions(batches.size());
+  std::vector<std::thread> workers{};
+
+  for (decltype(batches)::size_type i = 0; i < batches.size(); i++)
+    {
+      workers.emplace_back([&, i] {
+        try
+          {
+            std::vector<Token> tokens{ m_tokens.begin() + batches[i].first,
+                                       m_tokens.begin() + batches[i].second };
+            tokens.push_back(m_tokens.back());
+            programs[i] = Parser{ std::move(tokens), diagnostics[i] }.Parse();
+          }
+        catch (...)
+          {
+            exceptions[i] = std::current_exception();
+          }
+      });
+    }
+
+  for (auto& worker : workers)
+    worker.join();
+
+  for (decltype(batches)::size_type i = 0; i < batches.size(); i++)
+    if (exceptions[i])
+      std::rethrow_exception(exceptions[i]);
+
+  // A batch recovers from an error at its own end, where a sequential parse would skip on into the next
+  // statement, so only a program without errors is merged. Others are parsed again sequentially.
+  if (std::any_of(diagnostics.begin(), diagnostics.end(), [](const auto& batch) { return !batch.empty(); }))
+    return Parse();
+
+  std::unique_ptr<Program> program{ new Program };
+
+  for (auto& batch : programs)
+    program->take_stmts(*batch);
+
+  m_current = m_tokens.size();
+  return program;
+}
+
 Stmt*
 Parser::parse_stmt()
 {
@@ -231,20 +361,20 @@ Parser::parse_for_stmt()
       throw SynchronizationPoint{};
     }
 
+  std::unique_ptr<Expr> loop_var{ identifier };
+
   if (!match("in"))
     throw error("Expected 'in' after identifier in for statement", current_span());
 
-  Expr* range;
-  try
+  if (!match(TokenType::STRING))
     {
-      range = parse_expr();
-    }
-  catch (SynchronizationPoint& ex)
-    {
-      hint("Maybe you forgot to put an expression before the '{'?");
-      throw ex;
+      auto sync{ error("Expected a range after 'in'", current_span()) };
+      hint("Ranges are strings like \"0..10\", which goes from 0 to 9");
+      throw sync;
     }
 
+  auto [from, to]{ parse_range(previous()) };
+
   consume(TokenType::LBRACE);
 
   std::vector<std::unique_ptr<Stmt> > stmts = {};
@@ -252,7 +382,55 @@ Parser::parse_for_stmt()
     stmts.push_back(std::unique_ptr<Stmt>(parse_stmt()));
 
   consume(TokenType::RBRACE);
-  return new ForStmt{ std::unique_ptr<Expr>{ identifier }, std::unique_ptr<Expr>{ range }, std::move(stmts) };
+  return new ForStmt{ std::move(loop_var), std::move(from), std::move(to), std::move(stmts) };
+}
+
+std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr> >
+Parser::parse_range(const Token& range)
+{
+  auto lexeme{ range.lexeme_view() };
+  auto start{ range.span().start };
+
+  auto bound{ [&](std::size_t begin, std::size_t end) -> std::unique_ptr<Expr> {
+    while (begin < end && lexeme[begin] == ' ')
+      begin++;
+    while (end > begin && lexeme[end - 1] == ' ')
+      end--;
+
+    auto text{ lexeme.substr(begin, end - begin) };
+    Span span{ start + static_cast<int>(begin), start + static_cast<int>(end) };
+
+    auto digits{ text.substr(text.size() > 0 && text[0] == '-' ? 1 : 0) };
+    if (!digits.empty() && digits.find_first_not_of("0123456789") == std::string_view::npos)
+      {
+        int value{};
+        if (auto [_, ec]{ std::from_chars(text.data(), text.data() + text.size(), value) }; ec != std::errc{})
+          throw error("Range bound does not fit in 32 bits", span);
+        return std::make_unique<Number>(Token{ TokenType::NUMBER, text, span }, value);
+      }
+
+    auto is_identifier{ !text.empty() && text.find_first_not_of("abcdefghijklmnopqrstuvwxyz"
+                                                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_/")
+                                             == std::string_view::npos };
+    if (is_identifier && (text[0] < '0' || text[0] > '9'))
+      return std::make_unique<Identifier>(Token{ TokenType::IDENTIFIER, text, span });
+
+    auto sync{ error("Range bounds must be numbers or variables", span) };
+    hint("Ranges are strings like \"0..10\" or \"i..n\"");
+    throw sync;
+  } };
+
+  // The lexeme keeps its quotes.
+  auto dots{ lexeme.find("..") };
+  if (dots == std::string_view::npos || lexeme.size() < 2)
+    {
+      auto sync{ error("Expected '..' in range", range.span()) };
+      hint("Ranges are strings like \"0..10\", which goes from 0 to 9");
+      throw sync;
+    }
+
+  auto from{ bound(1, dots) };
+  return { std::move(from), bound(dots + 2, lexeme.size() - 1) };
 }
 
 LetStmt*
@@ -0,0 +1,38 @@
+#include "PassManager.hpp"
+
+namespace cat
+{
+
+void
+PassManager::Run(ir::Function& function)
+{
+  m_changes.resize(m_passes.size());
+
+  for (int iteration = 0; iteration < max_iterations; iteration++)
+    {
+      auto changed{ false };
+
+      for (std::size_t i = 0; i < m_passes.size(); i++)
+        if (m_passes[i]->Run(function))
+          {
+            m_changes[i]++;
+            changed = true;
+          }
+
+      if (!changed)
+        break;
+    }
+}
+
+std::vector<std::pair<const char*, int> >
+PassManager::changes() const
+{
+  std::vector<std::pair<const char*, int> > changes{};
+
+  for (std::size_t i = 0; i < m_passes.size(); i++)
+    changes.emplace_back(m_passes[i]->name(), i < m_changes.size() ? m_changes[i] : 0);
+
+  return changes;
+}
+
+}
@@ -0,0 +1,155 @@
+#include <numeric>
+
+#include "Peephole.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+bool
+is_branch(const Instruction& instruction) noexcept
+{
+  return instruction.is_control() && instruction.op != Instruction::Opcode::LABEL
+         && instruction.op != Instruction::Opcode::JAL && instruction.op != Instruction::Opcode::JR;
+}
+
+bool
+is_stack_adjustment(const Instruction& instruction) noexcept
+{
+  register_t sp{ register_t::name::SP };
+  return instruction.op == Instruction::Opcode::ADDI && instruction.rd == sp && instruction.rs == sp;
+}
+
+}
+
+const char*
+Peephole::name(Rule rule) noexcept
+{
+  switch (rule)
+    {
+    case Rule::REDUNDANT_MOVE:
+      return "redundant-move";
+    case Rule::STORE_LOAD:
+      return "store-load";
+    case Rule::CONSTANT_MOVE:
+      return "constant-move";
+    case Rule::STACK_ADJUSTMENT:
+      return "stack-adjustment";
+    case Rule::JUMP_TO_NEXT:
+      return "jump-to-next";
+    }
+
+  return "";
+}
+
+void
+Peephole::hit(Rule rule) noexcept
+{
+  m_hits[static_cast<int>(rule)]++;
+}
+
+bool
+Peephole::Run(std::vector<Instruction>& instructions)
+{
+  auto before{ std::accumulate(m_hits.begin(), m_hits.end(), 0) };
+
+  std::vector<Instruction> result{};
+  result.reserve(instructions.size());
+
+  for (std::size_t i = 0; i < instructions.size(); i++)
+    {
+      result.push_back(std::move(instructions[i]));
+
+      while (!result.empty() && apply(result, instructions, i + 1))
+        ;
+    }
+
+  instructions = std::move(result);
+  return std::accumulate(m_hits.begin(), m_hits.end(), 0) != before;
+}
+
+bool
+Peephole::apply(std::vector<Instruction>& result, const std::vector<Instruction>& instructions,
+                std::size_t next)
+{
+  using Opcode = Instruction::Opcode;
+
+  auto& last{ result.back() };
+
+  if (is_enabled(Rule::REDUNDANT_MOVE) && last.rd == last.rs
+      && (last.op == Opcode::MOVE || (last.op == Opcode::ADDI && last.imm == 0)))
+    {
+      result.pop_back();
+      hit(Rule::REDUNDANT_MOVE);
+      return true;
+    }
+
+  if (result.size() < 2)
+    return false;
+
+  auto& previous{ result[result.size() - 2] };
+
+  if (is_enabled(Rule::STORE_LOAD) && previous.op == Opcode::SW && last.op == Opcode::LW
+      && previous.rs == last.rs && previous.imm == last.imm)
+    {
+      if (last.rd == previous.rt)
+        result.pop_back();
+      else
+        last = Instruction::MOVE{ last.rd, previous.rt };
+
+      hit(Rule::STORE_LOAD);
+      return true;
+    }
+
+  if (is_enabled(Rule::CONSTANT_MOVE) && previous.op == Opcode::LI && last.op == Opcode::MOVE
+      && last.rs == previous.rd && is_dead(previous.rd, instructions, next))
+    {
+      previous.rd = last.rd;
+      result.pop_back();
+      hit(Rule::CONSTANT_MOVE);
+      return true;
+    }
+
+  if (is_enabled(Rule::STACK_ADJUSTMENT) && is_stack_adjustment(previous) && is_stack_adjustment(last))
+    {
+      previous.imm += last.imm;
+      result.pop_back();
+      if (previous.imm == 0)
+        result.pop_back();
+
+      hit(Rule::STACK_ADJUSTMENT);
+      return true;
+    }
+
+  if (is_enabled(Rule::JUMP_TO_NEXT) && last.op == Opcode::LABEL && is_branch(previous)
+      && previous.imm == last.imm)
+    {
+      result.erase(result.end() - 2);
+      hit(Rule::JUMP_TO_NEXT);
+      return true;
+    }
+
+  return false;
+}
+
+bool
+Peephole::is_dead(register_t reg, const std::vector<Instruction>& instructions, std::size_t next) noexcept
+{
+  for (auto i = next; i < instructions.size(); i++)
+    {
+      if (instructions[i].reads(reg))
+        return false;
+      if (instructions[i].writes(reg))
+        return true;
+
+      // The register may be read wherever control goes.
+      if (instructions[i].is_control())
+        return false;
+    }
+
+  return true;
+}
+
+}
@@ -0,0 +1,153 @@
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Passes.hpp"
+
+#define SERVICE_PRINT_INT 1
+#define SERVICE_PRINT_STRING 4
+#define SERVICE_PRINT_CHAR 11
+
+namespace cat
+{
+
+namespace
+{
+
+/// Return true if every escape in the contents of a string literal is one .asciiz reads as a single character.
+bool
+has_simple_escapes(const std::string& contents) noexcept
+{
+  for (std::size_t i = 0; i < contents.size(); i++)
+    if (contents[i] == '\\')
+      {
+        if (i + 1 == contents.size())
+          return false;
+
+        switch (contents[++i])
+          {
+          case 'n':
+          case 't':
+          case '\\':
+          case '"':
+            break;
+          default:
+            return false;
+          }
+      }
+
+  return true;
+}
+
+/// Return what `print` prints, as the contents of a string literal, or nothing if it is not known or can not be.
+std::optional<std::string>
+printed_text(const ir::Function& function, const ir::Instruction& print)
+{
+  auto operand{ print.operands[0] };
+
+  if (print.imm == SERVICE_PRINT_INT && operand->op == ir::Opcode::CONST)
+    return std::to_string(operand->imm);
+
+  if (print.imm == SERVICE_PRINT_CHAR && operand->op == ir::Opcode::CONST)
+    switch (auto c{ operand->imm })
+      {
+      case '\n':
+        return "\\n";
+      case '\t':
+        return "\\t";
+      case '"':
+        return "\\\"";
+      case '\\':
+        return "\\\\";
+      default:
+        // A NUL would end the string early.
+        if (c >= ' ' && c <= '~')
+          return std::string(1, static_cast<char>(c));
+        return std::nullopt;
+      }
+
+  if (print.imm == SERVICE_PRINT_STRING && operand->op == ir::Opcode::STRING)
+    {
+      const auto& literal{ function.strings[operand->imm] };
+      auto contents{ literal.substr(1, literal.size() - 2) };
+      if (has_simple_escapes(contents))
+        return contents;
+    }
+
+  return std::nullopt;
+}
+
+}
+
+bool
+PrintCoalescing::Run(ir::Function& function)
+{
+  auto changed{ false };
+
+  for (const auto& block : function.blocks)
+    {
+      std::vector<std::unique_ptr<ir::Instruction> > instructions{};
+      instructions.reserve(block->instructions.size());
+
+      // The run being merged: where its first print is, and what it prints.
+      std::size_t first{ 0 };
+      std::size_t length{ 0 };
+      std::string text{};
+
+      auto merge{ [&]() {
+        if (length > 1)
+          {
+            function.strings.push_back("\"" + text + "\"");
+
+            auto string{ std::make_unique<ir::Instruction>(ir::Opcode::STRING, function.value_count++,
+                                                           block.get()) };
+            string->imm = static_cast<int>(function.strings.size() - 1);
+
+            auto& print{ instructions[first] };
+            print->operands[0] = string.get();
+            print->imm = SERVICE_PRINT_STRING;
+            instructions.insert(instructions.begin() + first, std::move(string));
+            changed = true;
+          }
+
+        length = 0;
+        text.clear();
+      } };
+
+      for (auto& instruction : block->instructions)
+        {
+          if (instruction->op == ir::Opcode::PRINT)
+            {
+              if (auto printed{ printed_text(function, *instruction) })
+                {
+                  text += *printed;
+
+                  // Later prints of the run are dropped, the first one prints the whole text.
+                  if (length++ == 0)
+                    {
+                      first = instructions.size();
+                      instructions.push_back(std::move(instruction));
+                    }
+                  continue;
+                }
+            }
+          // Constants and string addresses do nothing, so a run goes on past them.
+          else if (instruction->op == ir::Opcode::CONST || instruction->op == ir::Opcode::STRING)
+            {
+              instructions.push_back(std::move(instruction));
+              continue;
+            }
+
+          merge();
+          instructions.push_back(std::move(instruction));
+        }
+
+      merge();
+      block->instructions = std::move(instructions);
+    }
+
+  return changed;
+}
+
+}
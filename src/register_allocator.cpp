@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <bitset>
+
+#include "Liveness.hpp"
+#include "RegisterAllocator.hpp"
+
+namespace cat
+{
+
+RegisterAllocator::RegisterAllocator(const ir::Function& function)
+{
+  number(function);
+  precolor(function);
+  build_intervals(function);
+  add_hints(function);
+  scan();
+  assign_slots();
+}
+
+void
+RegisterAllocator::number(const ir::Function& function)
+{
+  m_block_start.resize(function.block_count);
+  m_block_end.resize(function.block_count);
+  m_positions.resize(function.value_count);
+
+  std::size_t position{ 0 };
+
+  for (const auto& block : function.blocks)
+    {
+      // Phis are defined on entry to the block.
+      m_block_start[block->id] = position;
+
+      for (const auto& instruction : block->instructions)
+        {
+          if (instruction->op != ir::Opcode::PHI)
+            position += 2;
+          m_positions[instruction->id] = position;
+        }
+
+      // Values live on exit outlive the terminator, and the next block starts
+      // after them.
+      m_block_end[block->id] = position + 1;
+      position += 2;
+    }
+}
+
+void
+RegisterAllocator::precolor(const ir::Function& function)
+{
+  m_locations.resize(function.value_count);
+
+  std::vector<int> uses(function.value_count, 0);
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      for (auto operand : instruction->operands)
+        uses[operand->id]++;
+
+  m_folded.assign(function.value_count, false);
+
+  for (const auto& block : function.blocks)
+    {
+      const auto& instructions{ block->instructions };
+
+      // The operands of the comparison stay in their registers until the
+      // branch, since nothing is defined in between.
+      if (auto terminator{ block->terminator() };
+          terminator->op == ir::Opcode::BRANCH && instructions.size() > 1)
+        if (auto condition{ terminator->operands[0] };
+            ir::is_comparison(condition->op) && uses[condition->id] == 1
+            && instructions[instructions.size() - 2].get() == condition)
+          m_folded[condition->id] = true;
+
+      for (std::size_t i = 0; i < instructions.size(); i++)
+        {
+          if (instructions[i]->op != ir::Opcode::PRINT)
+            continue;
+
+          auto value{ instructions[i]->operands[0] };
+          if (!Liveness::is_tracked(*value) || value->op == ir::Opcode::PHI || value->block != block.get()
+              || uses[value->id] != 1)
+            continue;
+
+          // Another print in between would overwrite $a0.
+          auto j{ i };
+          while (j > 0 && instructions[j - 1].get() != value && instructions[j - 1]->op != ir::Opcode::PRINT)
+            j--;
+
+          if (j > 0 && instructions[j - 1].get() == value)
+            m_locations[value->id] = { Location::Kind::REGISTER, register_t{ register_t::name::A0 } };
+        }
+    }
+}
+
+void
+RegisterAllocator::build_intervals(const ir::Function& function)
+{
+  std::vector<Interval> intervals(function.value_count);
+  std::vector<bool> used(function.value_count, false);
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      {
+        auto position{ m_positions[instruction->id] };
+        intervals[instruction->id] = { instruction.get(), position, position };
+
+        // Phis are written by the copies at the end of their predecessors.
+        if (instruction->op == ir::Opcode::PHI)
+          for (auto predecessor : block->predecessors)
+            intervals[instruction->id].start
+                = std::min(intervals[instruction->id].start, m_positions[predecessor->terminator()->id]);
+      }
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      for (std::size_t i = 0; i < instruction->operands.size(); i++)
+        {
+          auto operand{ instruction->operands[i] };
+          if (!Liveness::is_tracked(*operand) || operand == instruction.get())
+            continue;
+
+          auto position{ instruction->op == ir::Opcode::PHI
+                             ? m_positions[block->predecessors[i]->terminator()->id]
+                             : m_positions[instruction->id] };
+
+          intervals[operand->id].end = std::max(intervals[operand->id].end, position);
+          used[operand->id] = true;
+        }
+
+  Liveness liveness{ function };
+
+  for (const auto& block : function.blocks)
+    {
+      for (auto value : liveness.live_in(*block))
+        intervals[value->id].start = std::min(intervals[value->id].start, m_block_start[block->id]);
+
+      // A value that only reaches the phis of a successor dies with the copies
+      // to them, so a phi can take its register.
+      for (auto value : liveness.live_out(*block))
+        {
+          auto is_live_in{ [&](const ir::BasicBlock* successor) {
+            return liveness.live_in(*successor).count(value) > 0;
+          } };
+
+          if (std::any_of(block->successors.begin(), block->successors.end(), is_live_in))
+            intervals[value->id].end = std::max(intervals[value->id].end, m_block_end[block->id]);
+        }
+    }
+
+  for (const auto& interval : intervals)
+    if (interval.value != nullptr && used[interval.value->id] && Liveness::is_tracked(*interval.value)
+        && m_locations[interval.value->id].kind == Location::Kind::NONE && !m_folded[interval.value->id])
+      m_intervals.push_back(interval);
+
+  std::stable_sort(m_intervals.begin(), m_intervals.end(),
+                   [](const Interval& a, const Interval& b) { return a.start < b.start; });
+}
+
+void
+RegisterAllocator::add_hints(const ir::Function& function)
+{
+  m_hints.resize(function.value_count);
+
+  for (const auto& block : function.blocks)
+    for (const auto& instruction : block->instructions)
+      {
+        if (instruction->op != ir::Opcode::PHI)
+          continue;
+
+        for (auto operand : instruction->operands)
+          if (Liveness::is_tracked(*operand) && operand != instruction.get())
+            {
+              m_hints[instruction->id].push_back(operand);
+              m_hints[operand->id].push_back(instruction.get());
+            }
+      }
+}
+
+void
+RegisterAllocator::scan()
+{
+  std::bitset<allocatable> free{};
+  free.set();
+
+  // The intervals holding a register, by increasing end.
+  std::vector<Interval> active{};
+
+  auto insert{ [&active](const Interval& interval) {
+    active.insert(std::upper_bound(active.begin(), active.end(), interval,
+                                   [](const Interval& a, const Interval& b) { return a.end < b.end; }),
+                  interval);
+  } };
+
+  for (const auto& interval : m_intervals)
+    {
+      // Operands read by the instruction defining the interval can give it their register.
+      auto expired{ std::find_if(active.begin(), active.end(),
+                                 [&interval](const Interval& a) { return a.end > interval.start; }) };
+
+      for (auto it = active.begin(); it != expired; it++)
+        free.set(m_locations[it->value->id].index - register_t::min_value);
+      active.erase(active.begin(), expired);
+
+      if (free.any())
+        {
+          auto pos{ 0 };
+          while (!free.test(pos))
+            pos++;
+
+          for (auto hint : m_hints[interval.value->id])
+            if (const auto& where{ m_locations[hint->id] };
+                where.kind == Location::Kind::REGISTER && where.index >= register_t::min_value
+                && where.index < first_scratch && free.test(where.index - register_t::min_value))
+              {
+                pos = where.index - register_t::min_value;
+                break;
+              }
+
+          free.reset(pos);
+          m_locations[interval.value->id] = { Location::Kind::REGISTER, register_t::min_value + pos };
+          insert(interval);
+          continue;
+        }
+
+      // Keep in registers the intervals that end first.
+      if (auto last{ active.back() }; last.end > interval.end)
+        {
+          m_locations[interval.value->id] = m_locations[last.value->id];
+          spill(last);
+          active.pop_back();
+          insert(interval);
+        }
+      else
+        spill(interval);
+    }
+}
+
+void
+RegisterAllocator::spill(const Interval& interval)
+{
+  m_locations[interval.value->id] = { Location::Kind::MEMORY, 0 };
+  m_spilled_intervals.push_back(interval);
+  m_spilled++;
+}
+
+void
+RegisterAllocator::assign_slots()
+{
+  std::stable_sort(m_spilled_intervals.begin(), m_spilled_intervals.end(),
+                   [](const Interval& a, const Interval& b) { return a.start < b.start; });
+
+  // The end of the last interval stored in every slot.
+  std::vector<std::size_t> slot_end{};
+
+  for (const auto& interval : m_spilled_intervals)
+    {
+      auto slot{ std::find_if(slot_end.begin(), slot_end.end(),
+                              [&interval](std::size_t end) { return end <= interval.start; }) };
+
+      if (slot == slot_end.end())
+        slot = slot_end.insert(slot_end.end(), interval.end);
+      else
+        *slot = interval.end;
+
+      m_locations[interval.value->id].index = 4 * static_cast<int>(slot - slot_end.begin());
+    }
+
+  m_spill_area_size = 4 * static_cast<int>(slot_end.size());
+}
+
+}
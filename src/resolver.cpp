@@ -0,0 +1,204 @@
+#include "Resolver.hpp"
+#include "ast.hpp"
+
+namespace cat
+{
+
+SymbolTable::symbol_t
+SymbolTable::intern(std::string_view name)
+{
+  auto [it, _] = m_symbols.try_emplace(name, static_cast<symbol_t>(m_symbols.size()));
+  return it->second;
+}
+
+bool
+Resolver::Resolve(ast::Program& program)
+{
+  enter_scope();
+  program.Accept(*this);
+  leave_scope();
+  return !m_had_error;
+}
+
+/*
+ * Scopes
+ */
+
+void
+Resolver::enter_scope() noexcept
+{
+  m_scopes.push_back(m_slots.size());
+}
+
+void
+Resolver::leave_scope() noexcept
+{
+  auto live{ m_scopes.back() };
+  m_scopes.pop_back();
+
+  while (m_slots.size() > live)
+    {
+      m_bindings[m_slots.back()].pop_back();
+      m_slots.pop_back();
+    }
+}
+
+void
+Resolver::declare(ast::Identifier& identifier)
+{
+  auto symbol{ m_symbols.intern(identifier.token().lexeme_view()) };
+  auto slot{ static_cast<int>(m_slots.size()) };
+
+  if (symbol >= m_bindings.size())
+    m_bindings.resize(symbol + 1);
+
+  m_bindings[symbol].push_back(slot);
+  m_slots.push_back(symbol);
+
+  if (slot + 1 > m_max_slots)
+    m_max_slots = slot + 1;
+
+  identifier.resolve(symbol, slot);
+}
+
+void
+Resolver::undeclared_variable_error(ast::Identifier& identifier)
+{
+  m_had_error = true;
+  m_diagnostics.emplace_back("Unbound variable " + identifier.name(), identifier.token().span());
+  m_diagnostics.emplace_back(Diagnostic::Severity::HINT, "Maybe you forgot to declare the variable?\n\n"
+                                                         "\t let "
+                                                             + identifier.name() + " := ...");
+}
+
+/*
+ * Statements
+ */
+
+void
+Resolver::VisitProgram(ast::Program& program)
+{
+  for (ast::Stmt* stmt : program.stmts())
+    stmt->Accept(*this);
+}
+
+void
+Resolver::VisitLetStmt(ast::LetStmt& stmt)
+{
+  // The value is resolved first, so that 'let x := x.' refers to an outer 'x'.
+  stmt.value().Accept(*this);
+  declare(stmt.identifier());
+}
+
+void
+Resolver::VisitIfStmt(ast::IfStmt& stmt)
+{
+  stmt.condition()->Accept(*this);
+
+  enter_scope();
+  for (auto branch_stmt : stmt.if_branch())
+    branch_stmt->Accept(*this);
+  leave_scope();
+
+  enter_scope();
+  for (auto branch_stmt : stmt.else_branch())
+    branch_stmt->Accept(*this);
+  leave_scope();
+}
+
+void
+Resolver::VisitForStmt(ast::ForStmt& stmt)
+{
+  stmt.from()->Accept(*this);
+  stmt.to()->Accept(*this);
+
+  enter_scope();
+  declare(*static_cast<ast::Identifier*>(stmt.loop_var().get()));
+  for (const auto& body_stmt : stmt.stmts())
+    body_stmt->Accept(*this);
+  leave_scope();
+}
+
+void
+Resolver::VisitPrintStmt(ast::PrintStmt& stmt)
+{
+  for (auto expr : stmt.exprs())
+    expr->Accept(*this);
+}
+
+void
+Resolver::VisitExprStmt(ast::ExprStmt& stmt)
+{
+  stmt.expr()->Accept(*this);
+}
+
+/*
+ * Expressions
+ */
+
+std::any
+Resolver::VisitNumber([[maybe_unused]] ast::Number& expr)
+{
+  return {};
+}
+
+std::any
+Resolver::VisitString([[maybe_unused]] ast::String& expr)
+{
+  return {};
+}
+
+std::any
+Resolver::VisitIdentifier(ast::Identifier& identifier)
+{
+  auto symbol{ m_symbols.intern(identifier.token().lexeme_view()) };
+
+  if (symbol < m_bindings.size() && !m_bindings[symbol].empty())
+    identifier.resolve(symbol, m_bindings[symbol].back());
+  else
+    undeclared_variable_error(identifier);
+
+  return {};
+}
+
+std::any
+Resolver::VisitAddExpr(ast::AddExpr& expr)
+{
+  expr.lhs()->Accept(*this);
+  expr.rhs()->Accept(*this);
+  return {};
+}
+
+std::any
+Resolver::VisitSubExpr(ast::SubExpr& expr)
+{
+  expr.lhs()->Accept(*this);
+  expr.rhs()->Accept(*this);
+  return {};
+}
+
+std::any
+Resolver::VisitMultExpr(ast::MultExpr& expr)
+{
+  expr.lhs()->Accept(*this);
+  expr.rhs()->Accept(*this);
+  return {};
+}
+
+std::any
+Resolver::VisitAssignExpr(ast::AssignExpr& expr)
+{
+  expr.lhs()->Accept(*this);
+  expr.rhs()->Accept(*this);
+  return {};
+}
+
+std::any
+Resolver::VisitComparisonExpr(ast::ComparisonExpr& expr)
+{
+  expr.lhs()->Accept(*this);
+  expr.rhs()->Accept(*this);
+  return {};
+}
+
+}
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Passes.hpp"
+
+namespace cat
+{
+
+namespace
+{
+
+/// What is known about a value: nothing yet, that it is always the same constant, or that it varies.
+struct Lattice
+{
+  enum class Kind
+  {
+    UNKNOWN,
+    CONSTANT,
+    VARYING
+  };
+
+  Kind kind = Kind::UNKNOWN;
+  int value = 0;
+
+  [[nodiscard]] bool
+  operator==(const Lattice& other) const noexcept
+  {
+    return kind == other.kind && (kind != Kind::CONSTANT || value == other.value);
+  }
+};
+
+const Lattice varying{ Lattice::Kind::VARYING };
+
+/// Return what is known about a value that is either `a` or `b`.
+Lattice
+meet(const Lattice& a, const Lattice& b) noexcept
+{
+  if (a.kind == Lattice::Kind::UNKNOWN)
+    return b;
+  if (b.kind == Lattice::Kind::UNKNOWN || a == b)
+    return a;
+  return varying;
+}
+
+/**
+ * Find the values that are constant and the edges that can be taken, by
+ * the algorithm of Wegman and Zadeck. Every value starts unknown and every
+ * edge untaken, and only the instructions of the blocks reached so far are
+ * evaluated, so a phi only meets the operands of the edges that can be
+ * taken and a branch on a constant only takes one of its edges.
+ */
+class Solver
+{
+public:
+  explicit Solver(const ir::Function& function)
+      : m_values(function.value_count), m_reached(function.block_count, false),
+        m_executable(function.block_count), m_users(function.value_count)
+  {
+    for (const auto& block : function.blocks)
+      {
+        m_executable[block->id].assign(block->successors.size(), false);
+        for (const auto& instruction : block->instructions)
+          for (auto operand : instruction->operands)
+            m_users[operand->id].push_back(instruction.get());
+      }
+
+    reach(function.entry());
+
+    while (!m_work.empty())
+      {
+        auto instruction{ m_work.back() };
+        m_work.pop_back();
+        if (m_reached[instruction->block->id])
+          visit(*instruction);
+      }
+  }
+
+  [[nodiscard]] const Lattice&
+  value(const ir::Instruction* instruction) const noexcept
+  {
+    return m_values[instruction->id];
+  }
+
+  [[nodiscard]] bool
+  is_reached(const ir::BasicBlock* block) const noexcept
+  {
+    return m_reached[block->id];
+  }
+
+  /// Return true if the edge to the successor number `successor` of `block` can be taken.
+  [[nodiscard]] bool
+  is_executable(const ir::BasicBlock* block, std::size_t successor) const noexcept
+  {
+    return m_executable[block->id][successor];
+  }
+
+private:
+  void
+  reach(ir::BasicBlock* block)
+  {
+    m_reached[block->id] = true;
+    for (const auto& instruction : block->instructions)
+      m_work.push_back(instruction.get());
+  }
+
+  void
+  take(ir::BasicBlock* block, std::size_t successor)
+  {
+    if (m_executable[block->id][successor])
+      return;
+    m_executable[block->id][successor] = true;
+
+    // The phis of a block reached before meet one more operand.
+    auto target{ block->successors[successor] };
+    if (!m_reached[target->id])
+      reach(target);
+    else
+      for (const auto& instruction : target->instructions)
+        if (instruction->op == ir::Opcode::PHI)
+          m_work.push_back(instruction.get());
+  }
+
+  /// Return true if any edge from `predecessor` to `block` can be taken.
+  [[nodiscard]] bool
+  is_any_executable(const ir::BasicBlock* predecessor, const ir::BasicBlock* block) const noexcept
+  {
+    for (std::size_t i = 0; i < predecessor->successors.size(); i++)
+      if (predecessor->successors[i] == block && m_executable[predecessor->id][i])
+        return true;
+    return false;
+  }
+
+  void
+  visit(const ir::Instruction& instruction)
+  {
+    auto block{ instruction.block };
+
+    switch (instruction.op)
+      {
+      case ir::Opcode::JUMP:
+        take(block, 0);
+        return;
+      case ir::Opcode::BRANCH:
+        {
+          const auto& condition{ value(instruction.operands[0]) };
+          if (condition.kind == Lattice::Kind::CONSTANT)
+            take(block, condition.value != 0 ? 0 : 1);
+          else if (condition.kind == Lattice::Kind::VARYING)
+            {
+              take(block, 0);
+              take(block, 1);
+            }
+          return;
+        }
+      case ir::Opcode::PRINT:
+      case ir::Opcode::RETURN:
+        return;
+      default:
+        break;
+      }
+
+    // Values only ever go down the lattice, so every instruction is visited a bounded number of times.
+    auto& current{ m_values[instruction.id] };
+    auto next{ meet(current, evaluate(instruction)) };
+    if (next == current)
+      return;
+
+    current = next;
+    m_work.insert(m_work.end(), m_users[instruction.id].begin(), m_users[instruction.id].end());
+  }
+
+  [[nodiscard]] Lattice
+  evaluate(const ir::Instruction& instruction) const
+  {
+    const auto& operands{ instruction.operands };
+
+    switch (instruction.op)
+      {
+      case ir::Opcode::CONST:
+        return { Lattice::Kind::CONSTANT, instruction.imm };
+      case ir::Opcode::PHI:
+        {
+          Lattice result{};
+          for (std::size_t i = 0; i < operands.size(); i++)
+            if (is_any_executable(instruction.block->predecessors[i], instruction.block))
+              result = meet(result, value(operands[i]));
+          return result;
+        }
+      case ir::Opcode::SELECT:
+        {
+          const auto& condition{ value(operands[0]) };
+          if (condition.kind == Lattice::Kind::CONSTANT)
+            return value(operands[condition.value != 0 ? 1 : 2]);
+          if (condition.kind == Lattice::Kind::VARYING)
+            return meet(value(operands[1]), value(operands[2]));
+          return {};
+        }
+      case ir::Opcode::ADD:
+      case ir::Opcode::SUB:
+      case ir::Opcode::MUL:
+      case ir::Opcode::LT:
+      case ir::Opcode::LTE:
+      case ir::Opcode::EQ:
+      case ir::Opcode::GT:
+      case ir::Opcode::GTE:
+        {
+          const auto& lhs{ value(operands[0]) };
+          const auto& rhs{ value(operands[1]) };
+
+          // x * 0 = 0 * x = 0, whatever x turns out to be.
+          auto is_zero{ [](const Lattice& l) { return l.kind == Lattice::Kind::CONSTANT && l.value == 0; } };
+          if (instruction.op == ir::Opcode::MUL && (is_zero(lhs) || is_zero(rhs)))
+            return { Lattice::Kind::CONSTANT, 0 };
+
+          if (lhs.kind == Lattice::Kind::CONSTANT && rhs.kind == Lattice::Kind::CONSTANT)
+            {
+              // An operation that traps is left to trap at run time.
+              if (auto result{ ir::evaluate(instruction.op, lhs.value, rhs.value) }; result)
+                return { Lattice::Kind::CONSTANT, *result };
+              return varying;
+            }
+
+          if (lhs.kind == Lattice::Kind::VARYING || rhs.kind == Lattice::Kind::VARYING)
+            return varying;
+          return {};
+        }
+      default:
+        return varying;
+      }
+  }
+
+  std::vector<Lattice> m_values;
+  std::vector<bool> m_reached;
+  /// Whether the edge to every successor of every block can be taken.
+  std::vector<std::vector<bool> > m_executable;
+  /// The instructions using every value.
+  std::vector<std::vector<ir::Instruction*> > m_users;
+  /// The instructions to evaluate again.
+  std::vector<ir::Instruction*> m_work = {};
+};
+
+}
+
+bool
+SparseConditionalConstantPropagation::Run(ir::Function& function)
+{
+  Solver solver{ function };
+
+  std::unordered_map<ir::Instruction*, ir::Instruction*> replacements{};
+  auto changed{ false };
+
+  for (const auto& block : function.blocks)
+    {
+      if (!solver.is_reached(block.get()))
+        continue;
+
+      // Phis must stay first, so constant phis are replaced by a constant after them.
+      std::vector<std::unique_ptr<ir::Instruction> > constants{};
+
+      for (const auto& instruction : block->instructions)
+        {
+          const auto& value{ solver.value(instruction.get()) };
+          if (value.kind != Lattice::Kind::CONSTANT || instruction->op == ir::Opcode::CONST)
+            continue;
+
+          if (instruction->op == ir::Opcode::PHI)
+            {
+              auto constant{ std::make_unique<ir::Instruction>(ir::Opcode::CONST, function.value_count++,
+                                                               block.get()) };
+              constant->imm = value.value;
+              replacements[instruction.get()] = constant.get();
+              constants.push_back(std::move(constant));
+              continue;
+            }
+
+          instruction->op = ir::Opcode::CONST;
+          instruction->operands.clear();
+          instruction->imm = value.value;
+          changed = true;
+        }
+
+      auto& instructions{ block->instructions };
+      auto position{ std::find_if(instructions.begin(), instructions.end(),
+                                  [](const auto& instruction) { return instruction->op != ir::Opcode::PHI; }) };
+      instructions.insert(position, std::make_move_iterator(constants.begin()),
+                          std::make_move_iterator(constants.end()));
+
+      // A branch that can only go one way jumps there. The blocks only the other edge led to are no longer
+      // reachable, and the phis there lose the operand of the edge.
+      auto terminator{ block->terminator() };
+      if (terminator->op != ir::Opcode::BRANCH
+          || solver.is_executable(block.get(), 0) == solver.is_executable(block.get(), 1))
+        continue;
+
+      auto to_taken{ solver.is_executable(block.get(), 0) };
+      auto taken{ block->successors[to_taken ? 0 : 1] };
+      auto dead{ block->successors[to_taken ? 1 : 0] };
+
+      dead->remove_predecessor(block.get());
+      block->successors = { taken };
+      terminator->op = ir::Opcode::JUMP;
+      terminator->operands.clear();
+      changed = true;
+    }
+
+  function.replace(replacements);
+  return changed || !replacements.empty();
+}
+
+}